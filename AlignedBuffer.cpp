@@ -0,0 +1,84 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "AlignedBuffer.h"
+
+#include <cstdint>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr std::size_t hugePageSize = 2 * 1024 * 1024;
+}
+
+AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+    : m_data{std::exchange(other.m_data, nullptr)},
+      m_capacity{std::exchange(other.m_capacity, 0)},
+      m_alignment{other.m_alignment},
+      m_hugePages{other.m_hugePages}
+{
+}
+
+AlignedBuffer &AlignedBuffer::operator=(AlignedBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_capacity = std::exchange(other.m_capacity, 0);
+        m_alignment = other.m_alignment;
+        m_hugePages = other.m_hugePages;
+    }
+    return *this;
+}
+
+AlignedBuffer::~AlignedBuffer()
+{
+    release();
+}
+
+bool AlignedBuffer::reserve(std::size_t bytes, bool hugePages)
+{
+    if (bytes <= m_capacity && hugePages == m_hugePages)
+        return false;
+    release();
+
+    // buffers smaller than a huge page wouldn't get one anyway
+    m_hugePages = hugePages;
+    m_alignment = hugePages && bytes >= hugePageSize ? hugePageSize : alignment;
+    m_capacity = (bytes + m_alignment - 1) / m_alignment * m_alignment;
+    m_data = static_cast<unsigned char *>(::operator new(m_capacity, std::align_val_t{m_alignment}));
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    // only a hint; the kernel may be configured to ignore it
+    if (m_alignment == hugePageSize)
+        madvise(m_data, m_capacity, MADV_HUGEPAGE);
+#endif
+    return true;
+}
+
+void AlignedBuffer::discard()
+{
+#if defined(__linux__)
+    // madvise() takes whole pages; the partial ones at either end keep their place
+    const auto pageSize = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    const auto begin = (reinterpret_cast<std::uintptr_t>(m_data) + pageSize - 1) / pageSize * pageSize;
+    const auto end = (reinterpret_cast<std::uintptr_t>(m_data) + m_capacity) / pageSize * pageSize;
+    if (m_data && begin < end)
+        madvise(reinterpret_cast<void *>(begin), end - begin, MADV_DONTNEED);
+#endif
+}
+
+void AlignedBuffer::release()
+{
+    if (m_data)
+        ::operator delete(m_data, std::align_val_t{m_alignment});
+    m_data = nullptr;
+    m_capacity = 0;
+}
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+
+// Raw bytes aligned to a cache line, for buffers that are reused from frame to frame. reserve() only goes back to the
+// allocator when the buffer has to grow, so a steady frame size costs no allocations and no page faults after the
+// first frame. The contents are left as they are, and are unspecified after a reallocation.
+class AlignedBuffer
+{
+public:
+    static constexpr std::size_t alignment = 64;
+
+    AlignedBuffer() = default;
+    AlignedBuffer(const AlignedBuffer &) = delete;
+    AlignedBuffer &operator=(const AlignedBuffer &) = delete;
+    AlignedBuffer(AlignedBuffer &&other) noexcept;
+    AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+    ~AlignedBuffer();
+
+    // Makes room for at least bytes bytes, and returns whether that took a new allocation. With hugePages, large buffers
+    // are aligned to 2 MiB and, on Linux, marked for transparent huge pages; switching hugePages reallocates.
+    bool reserve(std::size_t bytes, bool hugePages = false);
+    // Gives the whole pages of the buffer back to the system, keeping the allocation; the next write to each faults in a
+    // zeroed page on the NUMA node of the writing thread. Only does something on Linux.
+    void discard();
+
+    unsigned char *data() { return m_data; }
+    const unsigned char *data() const { return m_data; }
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    void release();
+
+    unsigned char *m_data = nullptr;
+    std::size_t m_capacity = 0;
+    std::size_t m_alignment = alignment;
+    bool m_hugePages = false;
+};
@@ -0,0 +1,106 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "CpuFeatures.h"
+
+#include <cstdint>
+
+#if defined(MANDELBROT_X86_KERNELS)
+    #if defined(_MSC_VER)
+        #include <immintrin.h>
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+namespace
+{
+#if defined(MANDELBROT_X86_KERNELS)
+    struct CpuidRegisters
+    {
+        std::uint32_t eax = 0;
+        std::uint32_t ebx = 0;
+        std::uint32_t ecx = 0;
+        std::uint32_t edx = 0;
+    };
+
+    CpuidRegisters cpuid(std::uint32_t leaf, std::uint32_t subleaf = 0)
+    {
+        CpuidRegisters r;
+    #if defined(_MSC_VER)
+        int regs[4];
+        __cpuidex(regs, leaf, subleaf);
+        r.eax = regs[0];
+        r.ebx = regs[1];
+        r.ecx = regs[2];
+        r.edx = regs[3];
+    #else
+        __cpuid_count(leaf, subleaf, r.eax, r.ebx, r.ecx, r.edx);
+    #endif
+        return r;
+    }
+
+    // XCR0 tells us which register files the OS saves on context switches
+    std::uint64_t xgetbv()
+    {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        std::uint32_t eax;
+        std::uint32_t edx;
+        __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<std::uint64_t>(edx) << 32) | eax;
+    #endif
+    }
+
+    bool bit(std::uint32_t value, int n)
+    {
+        return (value >> n) & 1;
+    }
+#endif
+} // namespace
+
+SimdLevel detectSimdLevel()
+{
+#if defined(MANDELBROT_X86_KERNELS)
+    const auto maxLeaf = cpuid(0).eax;
+    const auto features = cpuid(1);
+    if (!bit(features.edx, 26))
+        return SimdLevel::Scalar;
+
+    const bool osxsave = bit(features.ecx, 27);
+    const bool avx = bit(features.ecx, 28);
+    if (!osxsave || !avx || maxLeaf < 7)
+        return SimdLevel::Sse2;
+
+    const auto xcr0 = xgetbv();
+    const bool ymmSaved = (xcr0 & 0x6) == 0x6;
+    const bool zmmSaved = (xcr0 & 0xe6) == 0xe6;
+    const auto extended = cpuid(7);
+    if (ymmSaved && zmmSaved && bit(extended.ebx, 16))
+        return SimdLevel::Avx512;
+    if (ymmSaved && bit(extended.ebx, 5))
+        return SimdLevel::Avx2;
+    return SimdLevel::Sse2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::Scalar:
+        return "scalar";
+    case SimdLevel::Sse2:
+        return "SSE2";
+    case SimdLevel::Avx2:
+        return "AVX2";
+    case SimdLevel::Avx512:
+        return "AVX-512";
+    }
+    return "unknown";
+}
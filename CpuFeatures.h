@@ -0,0 +1,18 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+enum class SimdLevel
+{
+    Scalar,
+    Sse2,
+    Avx2,
+    Avx512,
+};
+
+// Queries cpuid (and whether the OS saves the wider registers) for the widest instruction set we have kernels for.
+SimdLevel detectSimdLevel();
+
+const char *simdLevelName(SimdLevel level);
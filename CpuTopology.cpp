@@ -0,0 +1,133 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+namespace
+{
+#if defined(__linux__)
+    // parses a sysfs CPU or node list like "0-3,8-11"
+    std::vector<int> readList(const std::string &path)
+    {
+        std::vector<int> ids;
+        std::ifstream file{path};
+        std::string list;
+        if (!std::getline(file, list))
+            return ids;
+        std::istringstream ranges{list};
+        std::string range;
+        while (std::getline(ranges, range, ','))
+        {
+            const auto dash = range.find('-');
+            try
+            {
+                const auto first = std::stoi(range.substr(0, dash));
+                const auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (auto id = first; id <= last; ++id)
+                    ids.push_back(id);
+            }
+            catch (const std::exception &)
+            {
+                return {};
+            }
+        }
+        return ids;
+    }
+
+    int readInt(const std::string &path, int fallback)
+    {
+        std::ifstream file{path};
+        int value;
+        return file >> value ? value : fallback;
+    }
+#endif
+} // namespace
+
+int CpuTopology::physicalCores() const
+{
+    std::set<std::pair<int, int>> cores;
+    for (const auto &cpu : cpus)
+        cores.insert({cpu.package, cpu.core});
+    return static_cast<int>(cores.size());
+}
+
+int CpuTopology::numaNodes() const
+{
+    std::set<int> nodes;
+    for (const auto &cpu : cpus)
+        nodes.insert(cpu.node);
+    return static_cast<int>(nodes.size());
+}
+
+CpuTopology detectCpuTopology()
+{
+    CpuTopology topology;
+#if defined(__linux__)
+    const std::string sysfs = "/sys/devices/system/";
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    const auto haveMask = sched_getaffinity(0, sizeof allowed, &allowed) == 0;
+    for (const auto id : readList(sysfs + "cpu/online"))
+    {
+        if (haveMask && id < CPU_SETSIZE && !CPU_ISSET(id, &allowed))
+            continue;
+        CpuTopology::Cpu cpu;
+        cpu.id = id;
+        const auto topologyPath = sysfs + "cpu/cpu" + std::to_string(id) + "/topology/";
+        cpu.package = readInt(topologyPath + "physical_package_id", 0);
+        // without a core id, count the CPU as a core of its own
+        cpu.core = readInt(topologyPath + "core_id", -1 - id);
+        topology.cpus.push_back(cpu);
+    }
+    // kernels without NUMA support have no node directory; everything is on node 0 then
+    for (const auto node : readList(sysfs + "node/online"))
+    {
+        for (const auto id : readList(sysfs + "node/node" + std::to_string(node) + "/cpulist"))
+        {
+            for (auto &cpu : topology.cpus)
+            {
+                if (cpu.id == id)
+                    cpu.node = node;
+            }
+        }
+    }
+    topology.detected = !topology.cpus.empty();
+#endif
+    if (topology.cpus.empty())
+    {
+        const auto threads = static_cast<int>(std::max(std::thread::hardware_concurrency(), 1u));
+        for (int id = 0; id < threads; ++id)
+            topology.cpus.push_back({id, 0, id, 0});
+    }
+    std::sort(topology.cpus.begin(), topology.cpus.end(), [](const auto &a, const auto &b) {
+        return std::tie(a.node, a.package, a.core, a.id) < std::tie(b.node, b.package, b.core, b.id);
+    });
+    return topology;
+}
+
+std::vector<CpuTopology::Cpu> workerCpus(const CpuTopology &topology, bool physicalCoresOnly)
+{
+    if (!physicalCoresOnly)
+        return topology.cpus;
+    std::vector<CpuTopology::Cpu> cpus;
+    for (const auto &cpu : topology.cpus)
+    {
+        if (cpus.empty() || cpus.back().package != cpu.package || cpus.back().core != cpu.core)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
@@ -0,0 +1,37 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <vector>
+
+struct CpuTopology
+{
+    struct Cpu
+    {
+        // the logical CPU number the OS schedules and pins by
+        int id = 0;
+        // SMT siblings share package and core
+        int package = 0;
+        int core = 0;
+        int node = 0;
+    };
+
+    // The CPUs this process may run on, sorted by NUMA node, package, core and id, so SMT siblings are next to each
+    // other and so are the cores of a node.
+    std::vector<Cpu> cpus;
+    // whether cpus came from sysfs; otherwise they are made up and can't be pinned to
+    bool detected = false;
+
+    int physicalCores() const;
+    int numaNodes() const;
+};
+
+// Reads the online CPUs, their core and package ids and the NUMA nodes from /sys/devices/system on Linux, limited to
+// the affinity mask of the process. Elsewhere every hardware thread counts as a core of its own, all on one node.
+CpuTopology detectCpuTopology();
+
+// The CPUs to run one render thread on each, in the order of topology.cpus: all of them, or with physicalCoresOnly the
+// first SMT thread of every core.
+std::vector<CpuTopology::Cpu> workerCpus(const CpuTopology &topology, bool physicalCoresOnly);
@@ -0,0 +1,96 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "AlignedBuffer.h"
+#include "MandelbrotKernel.h"
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// The counts of a frame, or part of one, stored as the countType() of the cap they were iterated with. Hand data() to
+// PointBatch::results; code that goes over many counts should use visit() rather than at() and set(). The storage is
+// cache line aligned and kept over reset(), see AlignedBuffer.
+class IterationBuffer
+{
+public:
+    IterationBuffer() = default;
+    IterationBuffer(std::size_t size, int maxIterations)
+    {
+        reset(size, maxIterations);
+    }
+
+    // Makes this a buffer of size counts for maxIterations, reusing the storage if it is big enough. The counts are
+    // unspecified until written. Returns whether the storage is new.
+    bool reset(std::size_t size, int maxIterations, bool hugePages = false)
+    {
+        m_type = countType(maxIterations);
+        m_size = size;
+        return m_bytes.reserve(size * countSize(m_type), hugePages);
+    }
+
+    // see AlignedBuffer::discard(); the counts are unspecified afterwards
+    void discard() { m_bytes.discard(); }
+
+    CountType type() const { return m_type; }
+    std::size_t size() const { return m_size; }
+
+    // the counts from index on
+    void *data(std::size_t index = 0) { return m_bytes.data() + index * countSize(m_type); }
+    const void *data(std::size_t index = 0) const { return m_bytes.data() + index * countSize(m_type); }
+
+    // Calls f with a pointer to the counts, as the type they are stored as.
+    template<typename F>
+    decltype(auto) visit(F &&f)
+    {
+        switch (m_type)
+        {
+        case CountType::UInt8:
+            return f(reinterpret_cast<std::uint8_t *>(m_bytes.data()));
+        case CountType::UInt16:
+            return f(reinterpret_cast<std::uint16_t *>(m_bytes.data()));
+        case CountType::UInt32:
+            break;
+        }
+        return f(reinterpret_cast<std::uint32_t *>(m_bytes.data()));
+    }
+
+    template<typename F>
+    decltype(auto) visit(F &&f) const
+    {
+        switch (m_type)
+        {
+        case CountType::UInt8:
+            return f(reinterpret_cast<const std::uint8_t *>(m_bytes.data()));
+        case CountType::UInt16:
+            return f(reinterpret_cast<const std::uint16_t *>(m_bytes.data()));
+        case CountType::UInt32:
+            break;
+        }
+        return f(reinterpret_cast<const std::uint32_t *>(m_bytes.data()));
+    }
+
+    int at(std::size_t index) const
+    {
+        return visit([index](const auto *counts) { return static_cast<int>(counts[index]); });
+    }
+
+    void set(std::size_t index, int count)
+    {
+        visit([index, count](auto *counts) { counts[index] = static_cast<std::remove_pointer_t<decltype(counts)>>(count); });
+    }
+
+    // copies count counts from index from to index to; the ranges must not overlap
+    void copy(std::size_t from, std::size_t count, std::size_t to)
+    {
+        std::memcpy(data(to), data(from), count * countSize(m_type));
+    }
+
+private:
+    CountType m_type = CountType::UInt32;
+    std::size_t m_size = 0;
+    AlignedBuffer m_bytes;
+};
@@ -4,9 +4,13 @@
 
 #include "MainWindow.h"
 
+#include <QCheckBox>
+#include <QComboBox>
+#include <QFormLayout>
 #include <QVBoxLayout>
 #include <QPushButton>
 #include <QRadioButton>
+#include <QSpinBox>
 #include <QProgressBar>
 
 MainWindow::MainWindow(QWidget *parent)
@@ -17,7 +21,7 @@ MainWindow::MainWindow(QWidget *parent)
 
     auto progress = new QProgressBar;
     progress->setMinimum(0);
-    progress->setMaximum(3);
+    progress->setMaximum(4);
     progress->setValue(0);
     layout->addWidget(progress);
 
@@ -25,76 +29,184 @@ MainWindow::MainWindow(QWidget *parent)
 
     auto fullSet = new QRadioButton{"Show full set"};
     auto spike = new QRadioButton{"Zoom in on left spike"};
+    auto spiral = new QRadioButton{"Zoom deep into the spiral at i"};
+    auto deepSpiral = new QRadioButton{"Zoom to 1e-100 at i"};
     fullSet->setChecked(true);
     layout->addWidget(fullSet);
     layout->addWidget(spike);
+    layout->addWidget(spiral);
+    layout->addWidget(deepSpiral);
+
+    auto settings = new QFormLayout;
+    auto precision = new QComboBox;
+    // same order as the Precision enum
+    precision->addItems({"float", "double", "long double", "double-double", "perturbation", "automatic"});
+    precision->setCurrentIndex(static_cast<int>(Precision::Automatic));
+    settings->addRow("Precision:", precision);
+    auto iterations = new QSpinBox;
+    iterations->setRange(0, 1000000);
+    iterations->setSingleStep(100);
+    iterations->setSpecialValueText("automatic");
+    iterations->setValue(100);
+    settings->addRow("Iterations:", iterations);
+    auto cpuKernel = new QComboBox;
+    // same order as the CpuKernel enum
+    cpuKernel->addItems({"SIMD", "interleaved scalar", "scalar"});
+    settings->addRow("CPU kernel:", cpuKernel);
+    auto periodicity = new QCheckBox{"Periodicity checking"};
+    settings->addRow(periodicity);
+    auto deferredBailout = new QCheckBox{"Deferred bailout"};
+    settings->addRow(deferredBailout);
+    auto subdivision = new QCheckBox{"Mariani-Silver subdivision"};
+    settings->addRow(subdivision);
+    auto progressive = new QCheckBox{"Progressive rendering"};
+    settings->addRow(progressive);
+    auto guessing = new QCheckBox{"Solid guessing"};
+    settings->addRow(guessing);
+    auto tileSize = new QSpinBox;
+    tileSize->setRange(0, 512);
+    tileSize->setSingleStep(16);
+    tileSize->setSpecialValueText("lines");
+    tileSize->setValue(64);
+    settings->addRow("Tile size:", tileSize);
+    auto partitioning = new QComboBox;
+    // same order as the Partitioning enum
+    partitioning->addItems({"work stealing", "static blocks", "round-robin", "dynamic", "guided"});
+    settings->addRow("Partitioning:", partitioning);
+    auto pinThreads = new QCheckBox{"Pin threads"};
+    settings->addRow(pinThreads);
+    auto physicalCores = new QCheckBox{"One thread per physical core"};
+    settings->addRow(physicalCores);
+    auto hugePages = new QCheckBox{"Huge pages"};
+    settings->addRow(hugePages);
+    layout->addLayout(settings);
 
     layout->addStretch(0);
 
     auto renderBtn = new QPushButton{"Re-render"};
     layout->addWidget(renderBtn);
-    renderBtn->setDisabled(true);
 
     setCentralWidget(cw);
 
     m_singleThread = new MandelbrotWidget{MandelbrotWidget::RenderType::CpuSingleThread};
     m_multiThread = new MandelbrotWidget{MandelbrotWidget::RenderType::CpuMultiThread};
+    m_simd = new MandelbrotWidget{MandelbrotWidget::RenderType::CpuSimd};
     m_compute = new MandelbrotWidget{MandelbrotWidget::RenderType::Gpu};
-    m_singleThread->show();
-    m_multiThread->show();
-    m_compute->show();
+    for (auto widget : renderWidgets())
+        widget->show();
 
     connect(fullSet, &QRadioButton::clicked, this, [this](bool checked) {
         if (!checked)
             return;
-        m_singleThread->setView(MandelbrotWidget::FractalView::EntireSet);
-        m_multiThread->setView(MandelbrotWidget::FractalView::EntireSet);
-        m_compute->setView(MandelbrotWidget::FractalView::EntireSet);
+        for (auto widget : renderWidgets())
+            widget->setView(MandelbrotWidget::FractalView::EntireSet);
     });
     connect(spike, &QRadioButton::clicked, this, [this](bool checked) {
         if (!checked)
             return;
-        m_singleThread->setView(MandelbrotWidget::FractalView::LeftSpike);
-        m_multiThread->setView(MandelbrotWidget::FractalView::LeftSpike);
-        m_compute->setView(MandelbrotWidget::FractalView::LeftSpike);
-    });
-
-    connect(renderBtn, &QPushButton::clicked, this, [this, renderBtn] {
-        renderBtn->setDisabled(true);
-        m_singleThread->rerender();
-        m_multiThread->rerender();
-        m_compute->rerender();
-    });
-
-    auto updateWidgets = [this, renderBtn, progress] {
-        if (m_singleThread->rendering() || m_multiThread->rendering() || m_compute->rendering())
-            renderBtn->setDisabled(true);
-        else
-            renderBtn->setEnabled(true);
-
-        auto progressCount = 3;
-        if (m_singleThread->rendering())
-            --progressCount;
-        if (m_multiThread->rendering())
-            --progressCount;
-        if (m_compute->rendering())
-            --progressCount;
+        for (auto widget : renderWidgets())
+            widget->setView(MandelbrotWidget::FractalView::LeftSpike);
+    });
+    connect(spiral, &QRadioButton::clicked, this, [this](bool checked) {
+        if (!checked)
+            return;
+        for (auto widget : renderWidgets())
+            widget->setView(MandelbrotWidget::FractalView::SpiralZoom);
+    });
+    connect(deepSpiral, &QRadioButton::clicked, this, [this](bool checked) {
+        if (!checked)
+            return;
+        for (auto widget : renderWidgets())
+            widget->setView(MandelbrotWidget::FractalView::DeepSpiralZoom);
+    });
+
+    connect(precision, &QComboBox::currentIndexChanged, this, [this](int index) {
+        for (auto widget : renderWidgets())
+            widget->setPrecision(static_cast<Precision>(index));
+    });
+    connect(iterations, &QSpinBox::valueChanged, this, [this](int value) {
+        for (auto widget : renderWidgets())
+            widget->setMaxIterations(value);
+    });
+    connect(cpuKernel, &QComboBox::currentIndexChanged, this, [this](int index) {
+        for (auto widget : renderWidgets())
+            widget->setCpuKernel(static_cast<CpuKernel>(index));
+    });
+
+    connect(periodicity, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setPeriodicityCheck(checked);
+    });
+    connect(deferredBailout, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setDeferredBailout(checked);
+    });
+    connect(subdivision, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setSubdivision(checked);
+    });
+    connect(progressive, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setProgressive(checked);
+    });
+    connect(guessing, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setGuessing(checked);
+    });
+
+    connect(tileSize, &QSpinBox::valueChanged, this, [this](int value) {
+        for (auto widget : renderWidgets())
+            widget->setTileSize(value);
+    });
+
+    connect(partitioning, &QComboBox::currentIndexChanged, this, [this](int index) {
+        for (auto widget : renderWidgets())
+            widget->setPartitioning(static_cast<Partitioning>(index));
+    });
+    connect(pinThreads, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setPinThreads(checked);
+    });
+    connect(physicalCores, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setPhysicalCoresOnly(checked);
+    });
+    connect(hugePages, &QCheckBox::toggled, this, [this](bool checked) {
+        for (auto widget : renderWidgets())
+            widget->setHugePages(checked);
+    });
+
+    // clicking again while the widgets are still rendering cancels those renders; the new ones keep what they finished
+    connect(renderBtn, &QPushButton::clicked, this, [this, progress] {
+        progress->setValue(0);
+        for (auto widget : renderWidgets())
+            widget->rerender();
+    });
+
+    auto updateWidgets = [this, progress] {
+        auto progressCount = 0;
+        for (auto widget : renderWidgets())
+            if (!widget->rendering())
+                ++progressCount;
         progress->setValue(progressCount);
     };
 
-    connect(m_singleThread, &MandelbrotWidget::doneRendering, this, updateWidgets);
-    connect(m_multiThread, &MandelbrotWidget::doneRendering, this, updateWidgets);
-    connect(m_compute, &MandelbrotWidget::doneRendering, this, updateWidgets);
+    for (auto widget : renderWidgets())
+        connect(widget, &MandelbrotWidget::doneRendering, this, updateWidgets);
 }
 
 MainWindow::~MainWindow()
 {
 }
 
+QList<MandelbrotWidget *> MainWindow::renderWidgets() const
+{
+    return {m_singleThread, m_multiThread, m_simd, m_compute};
+}
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    m_singleThread->close();
-    m_multiThread->close();
-    m_compute->close();
+    for (auto widget : renderWidgets())
+        widget->close();
 }
 
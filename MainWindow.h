@@ -18,9 +18,11 @@ public:
 
 private:
     void closeEvent(QCloseEvent *event) override;
+    QList<MandelbrotWidget *> renderWidgets() const;
 
 private:
     MandelbrotWidget *m_singleThread;
     MandelbrotWidget *m_multiThread;
+    MandelbrotWidget *m_simd;
     MandelbrotWidget *m_compute;
 };
@@ -0,0 +1,491 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+enum class Precision
+{
+    Single,
+    Double,
+    Extended,
+    // about 106 bits of mantissa from pairs of doubles, for zooms past what double can resolve
+    DoubleDouble,
+    // double offsets from a reference orbit computed at high precision, for zooms past double-double
+    Perturbation,
+    // chosen per frame from the pixel spacing, see automaticPrecision()
+    Automatic,
+};
+
+// What the CpuSingleThread and CpuMultiThread backends iterate with; CpuSimd always uses the widest SIMD kernel.
+enum class CpuKernel
+{
+    Simd,
+    // interleavedPoints independent points per loop, without vector instructions
+    Interleaved,
+    // one point at a time
+    Scalar,
+};
+
+// Iteration caps that have a pre-instantiated kernel. A constant trip count lets the compiler unroll the loop.
+constexpr int iterationCaps[] = {100, 256, 1000, 4096};
+
+// MaxIter of the kernels used for every other cap, which take it from PointBatch::maxIterations instead.
+constexpr int runtimeIterationCap = 0;
+
+// Counts are stored in the narrowest unsigned type that holds every count up to the cap, see countType(). At the usual
+// caps a frame then takes a quarter or half the memory of ints, and so does every pass over it.
+enum class CountType
+{
+    UInt8,
+    UInt16,
+    UInt32,
+};
+
+inline CountType countType(int maxIterations)
+{
+    if (maxIterations <= 0xff)
+        return CountType::UInt8;
+    if (maxIterations <= 0xffff)
+        return CountType::UInt16;
+    return CountType::UInt32;
+}
+
+inline std::size_t countSize(CountType type)
+{
+    switch (type)
+    {
+    case CountType::UInt8:
+        return 1;
+    case CountType::UInt16:
+        return 2;
+    case CountType::UInt32:
+        break;
+    }
+    return 4;
+}
+
+// The count type of a kernel whose cap is compiled in, the same as countType(MaxIter).
+template<int MaxIter>
+using FixedCount = std::conditional_t<(MaxIter <= 0xff),
+                                      std::uint8_t,
+                                      std::conditional_t<(MaxIter <= 0xffff), std::uint16_t, std::uint32_t>>;
+
+// Kernels for runtimeIterationCap are instantiated for every count type. This calls select with a value of the one for
+// maxIterations, so it can pick the instantiation by decltype. It repeats countType() rather than calling it, since
+// SimdKernelImpl.h uses it.
+template<typename Select>
+auto selectCountType(int maxIterations, Select select)
+{
+    if (maxIterations <= 0xff)
+        return select(std::uint8_t{});
+    if (maxIterations <= 0xffff)
+        return select(std::uint16_t{});
+    return select(std::uint32_t{});
+}
+
+struct KernelOptions
+{
+    // must not be Automatic; resolve it for the frame first
+    Precision precision = Precision::Double;
+    // any positive number; the ones in iterationCaps get a kernel with the cap compiled in
+    int maxIterations = 100;
+    // Brent-style orbit cycle detection, which lets interior points stop long before the cap
+    bool periodicityCheck = false;
+    // test for escape only every bailoutInterval iterations, see iterateMandelbrotDeferred(); only used by the scalar
+    // kernels and the GPU, and ignored with periodicityCheck
+    bool deferredBailout = false;
+};
+
+// Orbits that come back this close (squared distance) to a checkpoint are considered periodic. This is a few ulps, so
+// only orbits that have actually converged onto a cycle stop early.
+template<typename Real>
+constexpr Real periodicityEpsilon =
+    (16 * std::numeric_limits<Real>::epsilon()) * (16 * std::numeric_limits<Real>::epsilon());
+
+// The same for double-double arithmetic, whose epsilon is roughly the square of double's.
+constexpr double doubleDoublePeriodicityEpsilon =
+    (16 * std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon())
+    * (16 * std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon());
+
+// An unevaluated sum hi + lo, with |lo| at most half an ulp of hi.
+struct DoubleDouble
+{
+    double hi = 0;
+    double lo = 0;
+};
+
+// The orbit Z_0 = 0, Z_1, ... of a reference point, for perturbation kernels, which iterate each point as its (small)
+// difference from the reference. The first seriesIterations iterations of every point are replaced by a truncated
+// series in the point's offset u from the reference, scaled so |u| <= 1 for points within seriesRadius:
+// delta = a u + b u^2 + c u^3. Complex numbers are stored as (real, imaginary) pairs of doubles.
+struct PerturbationReference
+{
+    const double *orbit = nullptr;
+    int length = 0;
+    int seriesIterations = 0;
+    double seriesRadius = 1;
+    double a[2] = {};
+    double b[2] = {};
+    double c[2] = {};
+};
+
+// Kernels get their points as offsets from the center of the view, so the center can carry more precision than a
+// double. Each kernel adds the two at the precision it iterates in. The offsets aren't stored anywhere: kernels compute
+// them from the pixel's position in a frame of size x size pixels, stored by line, see pointOffset().
+struct PointBatch
+{
+    DoubleDouble centerX;
+    DoubleDouble centerY;
+    // Viewport::pixelSpacing()
+    double spacing = 0;
+    int size = 0;
+    // The frame index of the first pixel; the batch covers first, first + 1 and so on, or first + pixels[i] if pixels
+    // is set.
+    std::size_t first = 0;
+    const std::size_t *pixels = nullptr;
+    // the result of the batch's i-th pixel goes to results[i], which are of the kernel's count type
+    void *results = nullptr;
+    std::size_t count = 0;
+    // only read by kernels instantiated with runtimeIterationCap, and by code that needs the count type of results
+    int maxIterations = 0;
+    // the orbit of the center, only used by Precision::Perturbation kernels
+    const PerturbationReference *reference = nullptr;
+};
+
+// A batch kernel iterates batch.count points and writes the escape iteration (or 0 for points in the set) into
+// batch.results, as the countType() of the cap it was picked for. It returns how many points it skipped because
+// isInMainCardioidOrBulb() put them in the set without iterating.
+using MandelbrotBatchKernel = std::size_t (*)(const PointBatch &batch);
+
+// The offset of the batch's i-th pixel from the center. row runs along the real axis and line along the imaginary one.
+// SimdKernelImpl.h can't call this and repeats it.
+inline std::complex<double> pointOffset(const PointBatch &batch, std::size_t i)
+{
+    const auto pixel = batch.first + (batch.pixels ? batch.pixels[i] : i);
+    const auto half = batch.size / 2.0;
+    const auto row = static_cast<int>(pixel % batch.size);
+    const auto line = static_cast<int>(pixel / batch.size);
+    return {(row - half) * batch.spacing, (line - half) * batch.spacing};
+}
+
+// Closed-form membership test for the two largest components of the set, which would otherwise run to the cap.
+template<typename Real>
+bool isInMainCardioidOrBulb(Real cx, Real cy)
+{
+    const auto yy = cy * cy;
+    const auto x = cx - Real(0.25);
+    const auto q = x * x + yy;
+    if (q * (q + x) <= Real(0.25) * yy)
+        return true;
+    const auto x1 = cx + 1;
+    return x1 * x1 + yy <= Real(0.0625);
+}
+
+// The escape-time loop itself, without the shortcuts calculateMandelbrotBatch() takes first. With CheckPeriodicity, z is
+// saved whenever the iteration count reaches a power of two, and the loop stops as soon as the orbit returns to it.
+// maxIterations is only used if MaxIter is runtimeIterationCap.
+template<typename Real, int MaxIter, bool CheckPeriodicity>
+int iterateMandelbrot(Real cx, Real cy, int maxIterations = MaxIter)
+{
+    const auto cap = MaxIter == runtimeIterationCap ? maxIterations : MaxIter;
+    auto x = cx;
+    auto y = cy;
+    auto savedX = x;
+    auto savedY = y;
+    int checkpoint = 1;
+    for (int i = 0; i < cap; ++i)
+    {
+        const auto xx = x * x;
+        const auto yy = y * y;
+        const auto xy = x * y;
+        x = xx - yy + cx;
+        y = xy + xy + cy;
+        if (x * x + y * y > 4)
+            return i + 1;
+
+        if constexpr (CheckPeriodicity)
+        {
+            const auto dx = x - savedX;
+            const auto dy = y - savedY;
+            if (dx * dx + dy * dy <= periodicityEpsilon<Real>)
+                return 0;
+            if (i + 1 == checkpoint)
+            {
+                savedX = x;
+                savedY = y;
+                checkpoint *= 2;
+            }
+        }
+    }
+    return 0;
+}
+
+// How many iterations iterateMandelbrotDeferred() runs between escape tests.
+constexpr int bailoutInterval = 8;
+
+// The same results as iterateMandelbrot() without periodicity checking, but z is only tested every bailoutInterval
+// iterations, which takes the branch off the critical path. When a block ends outside the radius, the block is run
+// again from the z saved before it, this time testing every iteration, to find the exact one. Once |z| > 2 >= |c| it
+// only grows, so no point escapes and comes back within a block. It may overflow to inf or NaN though, which is why the
+// block test is written so that NaN fails it.
+template<typename Real, int MaxIter>
+int iterateMandelbrotDeferred(Real cx, Real cy, int maxIterations = MaxIter)
+{
+    const auto cap = MaxIter == runtimeIterationCap ? maxIterations : MaxIter;
+    auto x = cx;
+    auto y = cy;
+    int i = 0;
+    for (; i + bailoutInterval <= cap; i += bailoutInterval)
+    {
+        const auto blockX = x;
+        const auto blockY = y;
+        for (int j = 0; j < bailoutInterval; ++j)
+        {
+            const auto xx = x * x;
+            const auto yy = y * y;
+            const auto xy = x * y;
+            x = xx - yy + cx;
+            y = xy + xy + cy;
+        }
+        if (!(x * x + y * y <= 4))
+        {
+            x = blockX;
+            y = blockY;
+            break;
+        }
+    }
+    // the block that escaped, or what's left of the cap after the last full block
+    for (; i < cap; ++i)
+    {
+        const auto xx = x * x;
+        const auto yy = y * y;
+        const auto xy = x * y;
+        x = xx - yy + cx;
+        y = xy + xy + cy;
+        if (x * x + y * y > 4)
+            return i + 1;
+    }
+    return 0;
+}
+
+// Adds an offset to the center at the wider of Real and double, and rounds the sum to Real once.
+template<typename Real>
+Real coordinate(const DoubleDouble &center, double offset)
+{
+    using Wide = std::conditional_t<(sizeof(Real) > sizeof(double)), Real, double>;
+    return static_cast<Real>(static_cast<Wide>(center.hi) + static_cast<Wide>(offset) + static_cast<Wide>(center.lo));
+}
+
+template<typename Real,
+         int MaxIter,
+         bool CheckPeriodicity,
+         bool DeferredBailout = false,
+         typename Count = FixedCount<MaxIter>>
+std::size_t calculateMandelbrotBatch(const PointBatch &batch)
+{
+    const auto results = static_cast<Count *>(batch.results);
+    std::size_t skipped = 0;
+    for (std::size_t i = 0; i < batch.count; ++i)
+    {
+        const auto offset = pointOffset(batch, i);
+        const auto cx = coordinate<Real>(batch.centerX, offset.real());
+        const auto cy = coordinate<Real>(batch.centerY, offset.imag());
+        if (cx * cx + cy * cy > 4)
+            results[i] = 1;
+        else if (isInMainCardioidOrBulb(cx, cy))
+        {
+            results[i] = 0;
+            ++skipped;
+        }
+        else if constexpr (DeferredBailout)
+        {
+            const auto n = iterateMandelbrotDeferred<Real, MaxIter>(cx, cy, batch.maxIterations);
+            results[i] = static_cast<Count>(n);
+        }
+        else
+        {
+            const auto n = iterateMandelbrot<Real, MaxIter, CheckPeriodicity>(cx, cy, batch.maxIterations);
+            results[i] = static_cast<Count>(n);
+        }
+    }
+    return skipped;
+}
+
+// How many points calculateMandelbrotInterleaved() keeps in flight. Their iterations don't depend on each other, so the
+// CPU can overlap them instead of waiting on the latency of a single chain of multiplies.
+constexpr int interleavedPoints = 4;
+
+// The same iterations as calculateMandelbrotBatch(), so the same results, but on interleavedPoints points at once in
+// plain scalar code. A slot whose point escapes or reaches the cap is refilled with the next point of the batch right
+// away, so slow points don't hold up the others.
+template<typename Real, int MaxIter, bool CheckPeriodicity, typename Count = FixedCount<MaxIter>>
+std::size_t calculateMandelbrotInterleaved(const PointBatch &batch)
+{
+    const auto cap = MaxIter == runtimeIterationCap ? batch.maxIterations : MaxIter;
+    const auto results = static_cast<Count *>(batch.results);
+    std::size_t skipped = 0;
+    std::size_t next = 0;
+
+    std::size_t index[interleavedPoints];
+    Real cx[interleavedPoints];
+    Real cy[interleavedPoints];
+    Real x[interleavedPoints];
+    Real y[interleavedPoints];
+    Real savedX[interleavedPoints];
+    Real savedY[interleavedPoints];
+    int iterations[interleavedPoints];
+    int checkpoint[interleavedPoints];
+    bool active[interleavedPoints];
+
+    // loads the next point that needs iterating into slot, or parks the slot at 0 once the batch runs out
+    const auto refill = [&](int slot) {
+        while (next < batch.count)
+        {
+            const auto i = next++;
+            const auto offset = pointOffset(batch, i);
+            const auto px = coordinate<Real>(batch.centerX, offset.real());
+            const auto py = coordinate<Real>(batch.centerY, offset.imag());
+            if (px * px + py * py > 4)
+                results[i] = 1;
+            else if (isInMainCardioidOrBulb(px, py))
+            {
+                results[i] = 0;
+                ++skipped;
+            }
+            else
+            {
+                index[slot] = i;
+                cx[slot] = x[slot] = savedX[slot] = px;
+                cy[slot] = y[slot] = savedY[slot] = py;
+                iterations[slot] = 0;
+                checkpoint[slot] = 1;
+                active[slot] = true;
+                return true;
+            }
+        }
+        cx[slot] = x[slot] = savedX[slot] = 0;
+        cy[slot] = y[slot] = savedY[slot] = 0;
+        iterations[slot] = std::numeric_limits<int>::min();
+        active[slot] = false;
+        return false;
+    };
+
+    int activeSlots = 0;
+    for (int slot = 0; slot < interleavedPoints; ++slot)
+        activeSlots += refill(slot);
+
+    while (activeSlots > 0)
+    {
+        // The arithmetic of all slots first, with the tests folded into one flag instead of a branch per slot. Parked
+        // slots stay at 0 and never reach the cap.
+        auto anyDone = false;
+        for (int slot = 0; slot < interleavedPoints; ++slot)
+        {
+            const auto xx = x[slot] * x[slot];
+            const auto yy = y[slot] * y[slot];
+            const auto xy = x[slot] * y[slot];
+            x[slot] = xx - yy + cx[slot];
+            y[slot] = xy + xy + cy[slot];
+            anyDone |= (x[slot] * x[slot] + y[slot] * y[slot] > 4) | (++iterations[slot] == cap);
+        }
+        if (!anyDone && !CheckPeriodicity)
+            continue;
+
+        for (int slot = 0; slot < interleavedPoints; ++slot)
+        {
+            if (!active[slot])
+                continue;
+            const auto n = iterations[slot];
+            auto result = -1;
+            if (x[slot] * x[slot] + y[slot] * y[slot] > 4)
+                result = n;
+            else if constexpr (CheckPeriodicity)
+            {
+                const auto dx = x[slot] - savedX[slot];
+                const auto dy = y[slot] - savedY[slot];
+                if (dx * dx + dy * dy <= periodicityEpsilon<Real>)
+                    result = 0;
+                else if (n == checkpoint[slot])
+                {
+                    savedX[slot] = x[slot];
+                    savedY[slot] = y[slot];
+                    checkpoint[slot] *= 2;
+                }
+            }
+            if (result < 0 && n == cap)
+                result = 0;
+            if (result < 0)
+                continue;
+
+            results[index[slot]] = static_cast<Count>(result);
+            if (!refill(slot))
+                --activeSlots;
+        }
+    }
+    return skipped;
+}
+
+template<typename Real, bool CheckPeriodicity>
+MandelbrotBatchKernel interleavedKernel(int maxIterations)
+{
+    switch (maxIterations)
+    {
+    case 100:
+        return calculateMandelbrotInterleaved<Real, 100, CheckPeriodicity>;
+    case 256:
+        return calculateMandelbrotInterleaved<Real, 256, CheckPeriodicity>;
+    case 1000:
+        return calculateMandelbrotInterleaved<Real, 1000, CheckPeriodicity>;
+    case 4096:
+        return calculateMandelbrotInterleaved<Real, 4096, CheckPeriodicity>;
+    default:
+        return selectCountType(maxIterations, [](auto count) -> MandelbrotBatchKernel {
+            return calculateMandelbrotInterleaved<Real, runtimeIterationCap, CheckPeriodicity, decltype(count)>;
+        });
+    }
+}
+
+// Picks the instantiation for options.maxIterations.
+template<typename Real>
+MandelbrotBatchKernel interleavedKernel(const KernelOptions &options)
+{
+    return options.periodicityCheck ? interleavedKernel<Real, true>(options.maxIterations)
+                                    : interleavedKernel<Real, false>(options.maxIterations);
+}
+
+template<typename Real, bool CheckPeriodicity, bool DeferredBailout = false>
+MandelbrotBatchKernel scalarKernel(int maxIterations)
+{
+    switch (maxIterations)
+    {
+    case 100:
+        return calculateMandelbrotBatch<Real, 100, CheckPeriodicity, DeferredBailout>;
+    case 256:
+        return calculateMandelbrotBatch<Real, 256, CheckPeriodicity, DeferredBailout>;
+    case 1000:
+        return calculateMandelbrotBatch<Real, 1000, CheckPeriodicity, DeferredBailout>;
+    case 4096:
+        return calculateMandelbrotBatch<Real, 4096, CheckPeriodicity, DeferredBailout>;
+    default:
+        return selectCountType(maxIterations, [](auto count) -> MandelbrotBatchKernel {
+            return calculateMandelbrotBatch<Real, runtimeIterationCap, CheckPeriodicity, DeferredBailout, decltype(count)>;
+        });
+    }
+}
+
+// Picks the instantiation for options.maxIterations.
+template<typename Real>
+MandelbrotBatchKernel scalarKernel(const KernelOptions &options)
+{
+    if (options.periodicityCheck)
+        return scalarKernel<Real, true>(options.maxIterations);
+    return options.deferredBailout ? scalarKernel<Real, false, true>(options.maxIterations)
+                                   : scalarKernel<Real, false>(options.maxIterations);
+}
@@ -4,11 +4,20 @@
 
 #include "MandelbrotWidget.h"
 
+#include "IterationBuffer.h"
+#include "Partitioning.h"
+#include "Perturbation.h"
+#include "RenderThreadPool.h"
+#include "SimdKernels.h"
+#include "Subdivision.h"
+#include "Tiles.h"
+#include "Viewport.h"
+
 #include <QApplication>
 #include <QElapsedTimer>
+#include <QImage>
 #include <QPaintEvent>
 #include <QPainter>
-#include <QPen>
 #include <QPushButton>
 #include <QtConcurrent/QtConcurrent>
 
@@ -18,30 +27,479 @@
 namespace compute = boost::compute;
 using doublepair = std::pair<double, double>;
 
-#include <complex>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iterator>
 #include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <tuple>
+
+namespace
+{
+    QString precisionName(Precision precision)
+    {
+        switch (precision)
+        {
+        case Precision::Single:
+            return QStringLiteral("float");
+        case Precision::Double:
+            return QStringLiteral("double");
+        case Precision::Extended:
+            return QStringLiteral("long double");
+        case Precision::DoubleDouble:
+            return QStringLiteral("double-double");
+        case Precision::Perturbation:
+            return QStringLiteral("perturbation");
+        case Precision::Automatic:
+            return QStringLiteral("automatic");
+        }
+        return {};
+    }
+
+    QString partitioningName(Partitioning partitioning)
+    {
+        switch (partitioning)
+        {
+        case Partitioning::WorkStealing:
+            return QStringLiteral("work stealing");
+        case Partitioning::StaticBlocks:
+            return QStringLiteral("static blocks");
+        case Partitioning::RoundRobin:
+            return QStringLiteral("round-robin");
+        case Partitioning::Dynamic:
+            return QStringLiteral("dynamic");
+        case Partitioning::Guided:
+            return QStringLiteral("guided");
+        }
+        return {};
+    }
+
+    Viewport viewport(MandelbrotWidget::FractalView view)
+    {
+        switch (view)
+        {
+        case MandelbrotWidget::FractalView::EntireSet:
+            return {{-0.5}, {0}, 4};
+        case MandelbrotWidget::FractalView::LeftSpike:
+            return {{-1.575}, {0}, 0.25};
+        case MandelbrotWidget::FractalView::SpiralZoom:
+            return {{0}, {1}, 1e-24};
+        case MandelbrotWidget::FractalView::DeepSpiralZoom:
+            return {{0}, {1}, 1e-100, "0", "1"};
+        }
+        return {};
+    }
+
+    // The OpenCL functions are written against real/real2, so the same source serves both precisions. Literals are
+    // cast because devices without fp64 may reject double constants.
+    QString gpuPreamble(Precision precision)
+    {
+        // no fused multiply-adds, like the CPU kernels, so the deferred bailout replays a block bit for bit
+        const auto contraction = QStringLiteral("#pragma OPENCL FP_CONTRACT OFF\n");
+        if (precision == Precision::Single)
+            return contraction
+                + QStringLiteral("typedef float real;\ntypedef float2 real2;\n#define REAL_EPSILON FLT_EPSILON\n");
+        // a plain program doesn't get the fp64 pragma that Boost.Compute adds to its own kernels
+        return contraction + QStringLiteral("#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n")
+            + QStringLiteral("typedef double real;\ntypedef double2 real2;\n#define REAL_EPSILON DBL_EPSILON\n");
+    }
+
+    QString gpuInteriorSource(Precision precision)
+    {
+        return gpuPreamble(precision) + QStringLiteral(R"(
+int isInMainCardioidOrBulb(real2 c)
+{
+    real yy = c.y * c.y;
+    real x = c.x - (real)0.25;
+    real q = x * x + yy;
+    return q * (q + x) <= (real)0.25 * yy || (c.x + 1) * (c.x + 1) + yy <= (real)0.0625;
+}
+)");
+    }
+
+    QString gpuMandelbrotSource(const KernelOptions &options)
+    {
+        // same Brent-style check as iterateMandelbrot(); saved and checkpoint are declared below
+        const auto periodicitySource = QStringLiteral(R"(
+            real2 d = zSquaredPlusC - saved;
+            if (d.x * d.x + d.y * d.y <= (16 * REAL_EPSILON) * (16 * REAL_EPSILON))
+                return 0;
+            if (i + 1 == checkpoint)
+            {
+                saved = zSquaredPlusC;
+                checkpoint *= 2;
+            }
+)");
+        // the cap is baked into the source so the OpenCL compiler sees a constant trip count
+        const auto cap = QString::number(options.maxIterations);
+        if (options.deferredBailout && !options.periodicityCheck)
+        {
+            // same blocks and replay as iterateMandelbrotDeferred()
+            return gpuInteriorSource(options.precision) + QStringLiteral(R"(
+real2 iterate(real2 z, real2 c)
+{
+    real2 newzc;
+    newzc.x = (z.x * z.x) - (z.y * z.y) + c.x;
+    newzc.y = (2 * z.x * z.y) + c.y;
+    return newzc;
+}
 
-int calculateMandelbrot(std::complex<double> c)
+int calculateMandelbrotCompute(real2 c)
 {
-    if (std::abs(c) > 2)
+    if (sqrt(c.x * c.x + c.y * c.y) > 2)
         return 1;
+    else if (isInMainCardioidOrBulb(c))
+        return 0;
     else
     {
-        auto zSquaredPlusC = c;
-        for (int i = 0; i < 100; ++i)
+        real2 zSquaredPlusC = c;
+        int i = 0;
+        for (; i + %2 <= %1; i += %2)
+        {
+            real2 block = zSquaredPlusC;
+            for (int j = 0; j < %2; ++j)
+                zSquaredPlusC = iterate(zSquaredPlusC, c);
+            if (!(((zSquaredPlusC.x * zSquaredPlusC.x) + (zSquaredPlusC.y * zSquaredPlusC.y)) <= 4))
+            {
+                zSquaredPlusC = block;
+                break;
+            }
+        }
+        for (; i < %1; ++i)
         {
-            zSquaredPlusC = std::pow(zSquaredPlusC, 2) + c;
-            if (std::pow(zSquaredPlusC.real(), 2) + std::pow(zSquaredPlusC.imag(), 2) > 4)
+            zSquaredPlusC = iterate(zSquaredPlusC, c);
+            if (((zSquaredPlusC.x * zSquaredPlusC.x) + (zSquaredPlusC.y * zSquaredPlusC.y)) > 4)
                 return i + 1;
         }
         return 0;
     }
 }
+)")
+                .arg(cap, QString::number(bailoutInterval));
+        }
+
+        return gpuInteriorSource(options.precision) + QStringLiteral(R"(
+int calculateMandelbrotCompute(real2 c)
+{
+    if (sqrt(c.x * c.x + c.y * c.y) > 2)
+        return 1;
+    else if (isInMainCardioidOrBulb(c))
+        return 0;
+    else
+    {
+        real2 zSquaredPlusC = c;
+        real2 saved = c;
+        int checkpoint = 1;
+        for (int i = 0; i < %1; ++i)
+        {
+            real2 newzc;
+            newzc.x = (zSquaredPlusC.x * zSquaredPlusC.x) - (zSquaredPlusC.y * zSquaredPlusC.y) + c.x;
+            newzc.y = (2 * zSquaredPlusC.x * zSquaredPlusC.y) + c.y;
+            zSquaredPlusC = newzc;
+            if (((zSquaredPlusC.x * zSquaredPlusC.x) + (zSquaredPlusC.y * zSquaredPlusC.y)) > 4)
+                return i + 1;
+%2
+        }
+        return 0;
+    }
+}
+)")
+            .arg(cap, options.periodicityCheck ? periodicitySource : QString{});
+    }
+
+    struct GpuResult
+    {
+        std::chrono::nanoseconds offClock{};
+        std::size_t skipped = 0;
+    };
+
+    // The coordinate of a frame index, computed like pointOffset() and coordinate() on the CPU. The frame comes in as
+    // kernel arguments, so the program only depends on the kernel options and gets built once per precision and cap.
+    QString gpuPixelSource(const char *countType)
+    {
+        return QStringLiteral(R"(
+typedef %1 count_t;
+
+real2 pixelCoordinate(uint pixel, uint size, real centerXHi, real centerXLo, real centerYHi, real centerYLo,
+                      real spacing)
+{
+    real half = (real)size / 2;
+    real2 c;
+    c.x = centerXHi + ((real)(pixel % size) - half) * spacing + centerXLo;
+    c.y = centerYHi + ((real)(pixel / size) - half) * spacing + centerYLo;
+    return c;
+}
+
+__kernel void calculateMandelbrotPixels(__global const uint *pixels, uint first, uint size, real centerXHi,
+                                        real centerXLo, real centerYHi, real centerYLo, real spacing,
+                                        __global count_t *results)
+{
+    uint i = get_global_id(0);
+    uint pixel = pixels ? pixels[i] : first + i;
+    real2 c = pixelCoordinate(pixel, size, centerXHi, centerXLo, centerYHi, centerYLo, spacing);
+    results[i] = (count_t)calculateMandelbrotCompute(c);
+}
+
+__kernel void countMainCardioidOrBulbPixels(__global const uint *pixels, uint first, uint size, real centerXHi,
+                                            real centerXLo, real centerYHi, real centerYLo, real spacing,
+                                            __global uint *skipped)
+{
+    uint i = get_global_id(0);
+    uint pixel = pixels ? pixels[i] : first + i;
+    real2 c = pixelCoordinate(pixel, size, centerXHi, centerXLo, centerYHi, centerYLo, spacing);
+    if (sqrt(c.x * c.x + c.y * c.y) <= 2 && isInMainCardioidOrBulb(c))
+        atomic_inc(skipped);
+}
+)")
+            .arg(QString::fromLatin1(countType));
+    }
+
+    // The staging and device buffers of calculateOnGpu(), kept by the render context so they only grow, and the
+    // programs it built so far, keyed by their source.
+    struct GpuBuffers
+    {
+        std::vector<compute::uint_> pixels;
+        compute::vector<compute::uint_> devicePixels;
+        std::tuple<compute::vector<std::uint8_t>, compute::vector<std::uint16_t>, compute::vector<std::uint32_t>>
+            deviceResults;
+        compute::vector<compute::uint_> deviceSkipped;
+        std::map<std::string, compute::program> programs;
+    };
+
+    // Sets the batch's frame arguments, which both kernels of gpuPixelSource() take first. Devices get float
+    // coordinates for Precision::Single, so they never touch fp64, and double ones otherwise.
+    void setGpuFrameArguments(compute::kernel &kernel, const PointBatch &batch, Precision precision,
+                              GpuBuffers &buffers)
+    {
+        if (batch.pixels)
+            kernel.set_arg(0, buffers.devicePixels.get_buffer());
+        else
+            kernel.set_arg(0, sizeof(cl_mem), nullptr);
+        kernel.set_arg(1, static_cast<compute::uint_>(batch.first));
+        kernel.set_arg(2, static_cast<compute::uint_>(batch.size));
+        const double reals[] = {batch.centerX.hi, batch.centerX.lo, batch.centerY.hi, batch.centerY.lo, batch.spacing};
+        for (std::size_t i = 0; i < std::size(reals); ++i)
+        {
+            if (precision == Precision::Single)
+                kernel.set_arg(3 + i, static_cast<float>(reals[i]));
+            else
+                kernel.set_arg(3 + i, reals[i]);
+        }
+    }
+
+    // Iterates the pixels of batch, which the device computes the coordinates of itself.
+    GpuResult calculateOnGpu(const PointBatch &batch, const KernelOptions &options, const QElapsedTimer &timer,
+                             GpuBuffers &buffers)
+    {
+        GpuResult result;
+        if (batch.count == 0)
+            return result;
+        auto &queue = compute::system::default_queue();
+        try
+        {
+            selectCountType(options.maxIterations, [&](auto count) {
+                using Count = decltype(count);
+
+                // building the program is a one-off cost of the backend rather than of the frame, so it stays off
+                // the clock
+                const auto buildStart = timer.durationElapsed();
+                const auto source =
+                    (gpuMandelbrotSource(options) + gpuPixelSource(compute::type_name<Count>())).toStdString();
+                auto program = buffers.programs.find(source);
+                if (program == buffers.programs.end())
+                    program = buffers.programs
+                                  .emplace(source, compute::program::build_with_source(source, queue.get_context()))
+                                  .first;
+                result.offClock += timer.durationElapsed() - buildStart;
+
+                // frame indices are only uploaded for scattered pixels; a contiguous batch counts them up on the
+                // device
+                if (batch.pixels)
+                {
+                    auto &pixels = buffers.pixels;
+                    pixels.resize(batch.count);
+                    for (std::size_t i = 0; i < batch.count; ++i)
+                        pixels[i] = static_cast<compute::uint_>(batch.first + batch.pixels[i]);
+                    buffers.devicePixels.resize(pixels.size());
+                    compute::copy(pixels.begin(), pixels.end(), buffers.devicePixels.begin());
+                }
+
+                // the counts come back in the frame's count type, which is all that crosses the bus
+                auto &results_compute = std::get<compute::vector<Count>>(buffers.deviceResults);
+                results_compute.resize(batch.count);
+                auto calculateMandelbrotPixels = program->second.create_kernel("calculateMandelbrotPixels");
+                setGpuFrameArguments(calculateMandelbrotPixels, batch, options.precision, buffers);
+                calculateMandelbrotPixels.set_arg(8, results_compute.get_buffer());
+                queue.enqueue_1d_range_kernel(calculateMandelbrotPixels, 0, batch.count, 0);
+                compute::copy(results_compute.begin(), results_compute.end(), static_cast<Count *>(batch.results));
+
+                // an OpenCL kernel can't cheaply report what it skipped, so count that in a separate pass off the
+                // clock
+                const auto skipStart = timer.durationElapsed();
+                const compute::uint_ zero = 0;
+                buffers.deviceSkipped.resize(1);
+                compute::copy(&zero, &zero + 1, buffers.deviceSkipped.begin());
+                auto countMainCardioidOrBulbPixels = program->second.create_kernel("countMainCardioidOrBulbPixels");
+                setGpuFrameArguments(countMainCardioidOrBulbPixels, batch, options.precision, buffers);
+                countMainCardioidOrBulbPixels.set_arg(8, buffers.deviceSkipped.get_buffer());
+                queue.enqueue_1d_range_kernel(countMainCardioidOrBulbPixels, 0, batch.count, 0);
+                compute::uint_ skipped = 0;
+                compute::copy(buffers.deviceSkipped.begin(), buffers.deviceSkipped.end(), &skipped);
+                result.skipped = skipped;
+                result.offClock += timer.durationElapsed() - skipStart;
+            });
+        }
+        catch (const boost::wrapexcept<boost::compute::program_build_failure> &f)
+        {
+            std::cout << f.build_log() << std::endl;
+            std::cout << f.what() << std::endl;
+            std::cout << f.error_code() << std::endl;
+            std::cout << f.error_string() << std::endl;
+        }
+        return result;
+    }
+
+    QRgb escapeColor(MandelbrotWidget::RenderType renderType, int n)
+    {
+        const auto dark = 255 - std::min(static_cast<int>(255 / n / 4), 255);
+        const auto low = 255 - std::min(static_cast<int>(255 / n / 4) + 50, 255);
+        const auto high = 255 - std::min(static_cast<int>(255 / n / 0.8) + 50, 255);
+        switch (renderType)
+        {
+        case MandelbrotWidget::RenderType::CpuSingleThread:
+            return qRgb(dark, high, high);
+        case MandelbrotWidget::RenderType::CpuMultiThread:
+            return qRgb(high, low, high);
+        case MandelbrotWidget::RenderType::CpuSimd:
+            return qRgb(low, low, high);
+        case MandelbrotWidget::RenderType::Gpu:
+            return qRgb(high, high, low);
+        }
+        return qRgb(0, 0, 0);
+    }
+
+    // escapeColor() doesn't change past this count, so the palettes stop there whatever the cap
+    constexpr int lastPaletteCount = 256;
+
+    // The colours of escape counts 1 to lastPaletteCount, relative to the first escape in the frame, for renderType.
+    // Built once per render type; the tables are never dropped, so the references stay valid.
+    const std::vector<QRgb> &palette(MandelbrotWidget::RenderType renderType)
+    {
+        static std::mutex mutex;
+        static std::map<MandelbrotWidget::RenderType, std::vector<QRgb>> palettes;
+
+        std::lock_guard lock{mutex};
+        auto &palette = palettes[renderType];
+        if (palette.empty())
+        {
+            palette.resize(lastPaletteCount + 1, qRgb(0, 0, 0));
+            for (int n = 1; n <= lastPaletteCount; ++n)
+                palette[n] = escapeColor(renderType, n);
+        }
+        return palette;
+    }
+
+    // The palette spreads the counts past the first escape, 0 to span, as knee * log(1 + count / knee): one entry per
+    // count near the first escape, logarithmically further out, with the cap on the last entry. Returns 0 when span fits
+    // the palette one entry per count.
+    double paletteKnee(int span)
+    {
+        if (span < lastPaletteCount)
+            return 0;
+        // knee * log(1 + span / knee) grows from 0 towards span with knee
+        double low = 0;
+        double high = 1e9;
+        for (int i = 0; i < 64; ++i)
+        {
+            const auto knee = (low + high) / 2;
+            (knee * std::log1p(span / knee) < lastPaletteCount - 1 ? low : high) = knee;
+        }
+        return high;
+    }
+
+    // Writes results, stored by line, into the scan lines of an RGB32 image with the palette of renderType.
+    void colorize(QImage &image, MandelbrotWidget::RenderType renderType, const IterationBuffer &results, int size,
+                  int maxIterations)
+    {
+        const auto colors = palette(renderType).data();
+        results.visit([&](const auto *counts) {
+            // The palettes are made for counts that start at 1. In deep views even the fastest points take
+            // hundreds of iterations, so colour by the count past the first escape in the frame instead, scaled to the
+            // cap, see paletteKnee().
+            auto firstEscape = std::numeric_limits<int>::max();
+            for (std::size_t i = 0; i < results.size(); ++i)
+                if (counts[i] > 0)
+                    firstEscape = std::min(firstEscape, static_cast<int>(counts[i]));
+            const auto knee = paletteKnee(maxIterations - firstEscape);
+            const auto color = [&](int count) {
+                const auto past = count - firstEscape;
+                const auto index = knee > 0 ? 1 + static_cast<int>(std::lround(knee * std::log1p(past / knee))) : past + 1;
+                return colors[std::min(index, lastPaletteCount)];
+            };
+
+            // pixel (row, line) is stored at line * size + row, which is also its place in the image
+            for (int line = 0; line < size; ++line)
+            {
+                const auto scanLine = reinterpret_cast<QRgb *>(image.scanLine(line));
+                const auto lineCounts = counts + static_cast<std::size_t>(line) * size;
+                for (int row = 0; row < size; ++row)
+                {
+                    const auto count = static_cast<int>(lineCounts[row]);
+                    scanLine[row] = count == 0 ? qRgb(0, 0, 0) : color(count);
+                }
+            }
+        });
+    }
+
+    constexpr std::size_t pageSize = 4096;
+
+    // marks a tile or line in RenderContext::itemSkipped that hasn't been iterated yet
+    constexpr auto notDone = std::numeric_limits<std::size_t>::max();
+} // namespace
+
+// Identifies the frame a cancelled render was working on, see RenderContext::cancelledFrame.
+struct FrameKey
+{
+    MandelbrotWidget::FractalView view;
+    int size;
+    KernelOptions options;
+    int tileSize;
+
+    bool operator==(const FrameKey &other) const
+    {
+        return view == other.view && size == other.size && options.precision == other.options.precision
+            && options.maxIterations == other.options.maxIterations
+            && options.periodicityCheck == other.options.periodicityCheck && tileSize == other.tileSize;
+    }
+};
+
+// What rerender() reuses from one frame to the next. Renders of a widget don't overlap, and the mutex makes sure.
+struct RenderContext
+{
+    std::timed_mutex mutex;
+    IterationBuffer results;
+    IterationBuffer preview;
+    IterationBuffer pixelResults;
+    std::vector<std::size_t> pixels;
+    // created on first use, so the CPU widgets never touch OpenCL
+    std::optional<GpuBuffers> gpu;
+    // only for CpuMultiThread
+    std::optional<RenderThreadPool> threadPool;
+    // Per computed range of the frame, what the kernel skipped in each tile or line, or notDone. Only kept for a new
+    // render of cancelledFrame; results still holds the counts of the items that are done.
+    std::vector<std::size_t> itemSkipped[2];
+    std::optional<FrameKey> cancelledFrame;
+};
 
 MandelbrotWidget::MandelbrotWidget(RenderType renderType, QWidget *parent)
     : QWidget{parent},
       m_renderType{renderType},
-      m_debugLabel{new QLabel{this}}
+      m_debugLabel{new QLabel{this}},
+      m_context{std::make_unique<RenderContext>()}
 {
     const auto screenSize = qApp->primaryScreen()->availableSize();
     m_size = std::min(screenSize.width(), screenSize.height()) * 0.9;
@@ -53,149 +511,516 @@ MandelbrotWidget::MandelbrotWidget(RenderType renderType, QWidget *parent)
     rerender();
 }
 
+MandelbrotWidget::~MandelbrotWidget() = default;
+
 void MandelbrotWidget::setView(FractalView view)
 {
-    m_view = view;
+    m_settings.view = view;
+}
+
+void MandelbrotWidget::setPrecision(Precision precision)
+{
+    m_settings.precision = precision;
+}
+
+void MandelbrotWidget::setMaxIterations(int maxIterations)
+{
+    m_settings.maxIterations = maxIterations;
+}
+
+void MandelbrotWidget::setPeriodicityCheck(bool enabled)
+{
+    m_settings.periodicityCheck = enabled;
+}
+
+void MandelbrotWidget::setDeferredBailout(bool enabled)
+{
+    m_settings.deferredBailout = enabled;
+}
+
+void MandelbrotWidget::setSubdivision(bool enabled)
+{
+    m_settings.subdivision = enabled;
+}
+
+void MandelbrotWidget::setCpuKernel(CpuKernel kernel)
+{
+    m_settings.cpuKernel = kernel;
+}
+
+void MandelbrotWidget::setProgressive(bool enabled)
+{
+    m_settings.progressive = enabled;
+}
+
+void MandelbrotWidget::setGuessing(bool enabled)
+{
+    m_settings.guessing = enabled;
+}
+
+void MandelbrotWidget::setTileSize(int tileSize)
+{
+    m_settings.tileSize = tileSize;
+}
+
+void MandelbrotWidget::setPartitioning(Partitioning partitioning)
+{
+    m_settings.partitioning = partitioning;
+}
+
+void MandelbrotWidget::setPinThreads(bool enabled)
+{
+    m_settings.pinThreads = enabled;
+}
+
+void MandelbrotWidget::setPhysicalCoresOnly(bool enabled)
+{
+    m_settings.physicalCoresOnly = enabled;
+}
+
+void MandelbrotWidget::setHugePages(bool enabled)
+{
+    m_settings.hugePages = enabled;
 }
 
 void MandelbrotWidget::rerender()
 {
     m_doneRendering = false;
+    m_previewShown = false;
     m_debugLabel->setText({});
 
     // we're using a dedicated thread pool for this lambda because it doesn't actually consume a significant amount of CPU;
-    // therefore, it can coexist with a render thread on the same core
+    // therefore, it can coexist with a render thread on the same core. One thread per render widget, so none of them
+    // waits for another's render to finish.
     static auto threadPool = new QThreadPool{this};
-    threadPool->setMaxThreadCount(3);
-    auto renderJob = QtConcurrent::run(threadPool, [this] {
-        QPainter painter(&m_pixmap);
+    threadPool->setMaxThreadCount(4);
+    // A new render supersedes the one before: that one stops at its next tile or line, and one still waiting for the
+    // render context gives up within a millisecond, so a burst of requests only renders the last and holds at most one
+    // driver thread per widget while waiting.
+    const auto generation = ++m_generation;
+    // the viewport, kernel options and frame key all come from this one copy, taken on the GUI thread like the setters
+    const auto settings = m_settings;
+    auto renderJob = QtConcurrent::run(threadPool, [this, generation, settings] {
+        const auto cancelled = [this, generation] { return m_generation.load(std::memory_order_relaxed) != generation; };
+        if (cancelled())
+            return;
+        const auto view = viewport(settings.view);
+        const auto symmetry = realAxisSymmetry(view, m_size);
+
+        KernelOptions options;
+        options.precision =
+            settings.precision == Precision::Automatic ? automaticPrecision(view, m_size) : settings.precision;
+        options.maxIterations = settings.maxIterations > 0 ? settings.maxIterations : automaticIterationCap(view);
+        // perturbation kernels have no periodicity check, see calculateMandelbrotLanesPerturbed()
+        options.periodicityCheck = settings.periodicityCheck && options.precision != Precision::Perturbation;
+        options.deferredBailout = settings.deferredBailout && !options.periodicityCheck;
+        const auto kernel =
+            m_renderType == RenderType::CpuSimd ? simdKernel(options) : cpuKernel(settings.cpuKernel, options);
+        // the GPU honours it as asked; on the CPU only some kernels do, and the label should say what actually ran
+        if (m_renderType != RenderType::Gpu)
+            options.deferredBailout = kernel.deferredBailout;
+
+        // GPU, subdivided and progressive renders only stop between passes, so wait for them in short steps
+        std::unique_lock contextLock{m_context->mutex, std::defer_lock};
+        while (!contextLock.try_lock_for(std::chrono::milliseconds{1}))
+        {
+            if (cancelled())
+                return;
+        }
+        if (cancelled())
+            return;
+        auto &context = *m_context;
+        const auto subdivide = settings.subdivision && m_renderType != RenderType::Gpu;
+        const auto progressive = settings.progressive && !subdivide;
+        const auto guessing = settings.guessing && !subdivide;
+        const auto tiled =
+            settings.tileSize > 0 && m_renderType != RenderType::Gpu && !subdivide && !progressive && !guessing;
+
+        // the multi-threaded renderer's own threads, started again when their placement changes; subdivision stays on
+        // the global thread pool
+        const auto usesRenderPool = m_renderType == RenderType::CpuMultiThread && !subdivide;
+        auto newThreads = false;
+        if (usesRenderPool
+            && (!context.threadPool || context.threadPool->pinned() != settings.pinThreads
+                || context.threadPool->physicalCoresOnly() != settings.physicalCoresOnly))
+        {
+            context.threadPool.reset();
+            context.threadPool.emplace(settings.pinThreads, settings.physicalCoresOnly);
+            newThreads = true;
+        }
+
+        auto &results = context.results;
+        const auto newResults =
+            results.reset(static_cast<std::size_t>(m_size) * m_size, options.maxIterations, settings.hugePages);
+        // pages already written stay on the nodes of the threads that wrote them, so new threads get fresh ones to place
+        if (newThreads && !newResults)
+            results.discard();
+        PointBatch batch{view.centerX, view.centerY, view.pixelSpacing(m_size), m_size};
+        batch.results = results.data();
+        batch.count = results.size();
+        batch.maxIterations = options.maxIterations;
 
-        std::vector<QPoint> pixels;
-        std::vector<std::complex<double>> points;
-        for (int row = 0; row < m_size; ++row)
+        // The plain CPU paths remember which of their tiles or lines are done. When a render was cancelled, a new one
+        // of the same frame picks up the counts it left behind instead of iterating them again.
+        const auto resumable = m_renderType != RenderType::Gpu && !subdivide && !progressive && !guessing;
+        const FrameKey frameKey{settings.view, m_size, options, tiled ? settings.tileSize : 0};
+        const auto resume = resumable && !newResults && !newThreads && context.cancelledFrame == frameKey;
+        context.cancelledFrame.reset();
+        std::size_t reused = 0;
+        std::size_t workItems = 0;
+
+        // The work items of those paths: the tiles of each computed range, or else its single lines, which keep the
+        // batches long enough to fill the SIMD lanes. Both ranges start out not done unless resuming, before any of
+        // them is rendered, so a render cancelled early can't leave marks from an older frame behind.
+        std::vector<Tile> rangeTiles[2];
+        std::size_t rangeItems[2] = {};
+        for (int rangeIndex = 0; rangeIndex < 2; ++rangeIndex)
         {
-            for (int col = 0; col < m_size; ++col)
+            const auto lines = std::max(symmetry.computed[rangeIndex].last - symmetry.computed[rangeIndex].first, 0);
+            rangeTiles[rangeIndex] = frameTiles(lines, m_size, tiled ? settings.tileSize : 0);
+            rangeItems[rangeIndex] = tiled ? rangeTiles[rangeIndex].size() : static_cast<std::size_t>(lines);
+            if (!resume)
+                context.itemSkipped[rangeIndex].assign(rangeItems[rangeIndex], notDone);
+        }
+
+        // Place the pages of the frame on the NUMA nodes of the threads that will write them. A fresh page lands on the
+        // node of the thread that touches it first, so the work items of the computed ranges are touched through
+        // runPartitioned() too; with static blocks, round-robin and work stealing each item starts on the same thread
+        // when rendering. The mirrored lines are only copied.
+        if (usesRenderPool && (newResults || newThreads))
+        {
+            const auto countBytes = countSize(results.type());
+            const auto bytes = static_cast<unsigned char *>(results.data());
+            for (int rangeIndex = 0; rangeIndex < 2; ++rangeIndex)
             {
-                switch (m_view)
-                {
-                case MandelbrotWidget::FractalView::EntireSet:
-                    points.push_back({-2.5 + (4.0 * row / m_size), -2.0 + (4.0 * col / m_size)});
-                    break;
-                case MandelbrotWidget::FractalView::LeftSpike:
-                    points.push_back({-1.7 + (0.25 * row / m_size), -0.125 + (0.25 * col / m_size)});
-                    break;
-                }
-                pixels.push_back({row, col});
+                const auto &range = symmetry.computed[rangeIndex];
+                const auto touchItem = [&](std::size_t item) {
+                    const auto tile = tiled ? rangeTiles[rangeIndex][item] : Tile{static_cast<int>(item), 0, 1, m_size};
+                    for (auto line = tile.firstLine; line < tile.firstLine + tile.lines; ++line)
+                    {
+                        const auto pixel = static_cast<std::size_t>(range.first + line) * m_size + tile.firstRow;
+                        const auto last = (pixel + tile.rows) * countBytes;
+                        for (auto i = pixel * countBytes; i < last; i = (i / pageSize + 1) * pageSize)
+                            bytes[i] = 0;
+                    }
+                };
+                runPartitioned(settings.partitioning, rangeItems[rangeIndex], *context.threadPool, touchItem);
             }
         }
-        std::vector<int> results(points.size());
+
+        // the GPU has no long double, double-double or perturbation
+        if (m_renderType == RenderType::Gpu && options.precision != Precision::Single)
+            options.precision = Precision::Double;
+
+        if (m_renderType == RenderType::Gpu && !context.gpu)
+            context.gpu.emplace();
+
+        std::size_t skipped = 0;
+        std::size_t steals = 0;
+        // work that isn't part of rendering the frame, like counting what the GPU skipped or painting previews
+        std::chrono::nanoseconds offClock{};
+        std::optional<std::chrono::nanoseconds> firstPreview;
 
         QElapsedTimer timer;
         timer.start();
-        if (m_renderType == RenderType::CpuSingleThread)
-            for (int i = 0; i < points.size(); ++i)
-                results[i] = calculateMandelbrot(points[i]);
-        else if (m_renderType == RenderType::CpuMultiThread)
-            results =
-                QtConcurrent::blockingMapped(points, [](const std::complex<double> &point) -> int {
-                    return calculateMandelbrot(point);
+
+        // iterates the given pixels with this widget's backend, as one batch
+        const auto calculatePixels = [&](const std::vector<std::size_t> &pixels) {
+            auto &pixelResults = context.pixelResults;
+            pixelResults.reset(pixels.size(), options.maxIterations, settings.hugePages);
+            auto pixelBatch = batch;
+            pixelBatch.pixels = pixels.data();
+            pixelBatch.results = pixelResults.data();
+            pixelBatch.count = pixels.size();
+            if (m_renderType == RenderType::Gpu)
+            {
+                const auto gpu = calculateOnGpu(pixelBatch, options, timer, *context.gpu);
+                offClock += gpu.offClock;
+                skipped += gpu.skipped;
+            }
+            else if (m_renderType == RenderType::CpuMultiThread)
+            {
+                // chunks of a line each, handed out like the full frame below
+                const auto chunks = (pixels.size() + m_size - 1) / m_size;
+                std::atomic<std::size_t> skippedChunks{0};
+                steals += runPartitioned(settings.partitioning, chunks, *context.threadPool, [&](std::size_t chunk) {
+                    if (cancelled())
+                        return;
+                    auto chunkBatch = pixelBatch;
+                    chunkBatch.pixels += chunk * m_size;
+                    chunkBatch.results = pixelResults.data(chunk * m_size);
+                    chunkBatch.count = std::min<std::size_t>(m_size, pixelBatch.count - chunk * m_size);
+                    skippedChunks += kernel.calculate(chunkBatch);
                 });
-        else if (m_renderType == RenderType::Gpu)
+                skipped += skippedChunks;
+            }
+            else
+                skipped += kernel.calculate(pixelBatch);
+            results.visit([&](auto *counts) {
+                const auto pixelCounts = static_cast<decltype(counts)>(pixelResults.data());
+                for (std::size_t i = 0; i < pixels.size(); ++i)
+                    counts[pixels[i]] = pixelCounts[i];
+            });
+        };
+
+        // the reference orbit is part of the work of a frame, so it's computed on the clock
+        std::optional<ReferenceOrbit> referenceOrbit;
+        if (m_renderType != RenderType::Gpu && options.precision == Precision::Perturbation)
         {
-            try
+            referenceOrbit.emplace(view, options.maxIterations);
+            batch.reference = &referenceOrbit->reference();
+        }
+
+        SubdivisionStats subdivision;
+        std::size_t guessed = 0;
+        if (progressive || guessing)
+        {
+            // Every 4th pixel of every 4th line first, then every 2nd, then the rest. Each pass only iterates what the
+            // ones before it haven't. When progressive, each is shown with every sample stretched over the pixels it
+            // stands for.
+            for (const auto stride : {4, 2, 1})
             {
-                BOOST_COMPUTE_FUNCTION(int, calculateMandelbrotCompute, (std::complex<double> c), {
-                    if (sqrt(c.x * c.x + c.y * c.y) > 2)
-                        return 1;
-                    else
+                if (cancelled())
+                    return;
+                const auto inPass = [stride](int row, int line) {
+                    return row % stride == 0 && line % stride == 0
+                        && (stride == 4 || row % (2 * stride) != 0 || line % (2 * stride) != 0);
+                };
+                auto &pixels = context.pixels;
+                pixels.clear();
+                for (const auto &range : symmetry.computed)
+                {
+                    const auto lines = range.last - range.first;
+                    for (int line = 0; line < lines; ++line)
                     {
-                        double2 zSquaredPlusC = c;
-                        for (int i = 0; i < 100; ++i)
+                        for (int row = 0; row < m_size; ++row)
                         {
-                            double2 newzc;
-                            newzc.x = (zSquaredPlusC.x * zSquaredPlusC.x) - (zSquaredPlusC.y * zSquaredPlusC.y) + c.x;
-                            newzc.y = (2 * zSquaredPlusC.x * zSquaredPlusC.y) + c.y;
-                            zSquaredPlusC = newzc;
-                            if (((zSquaredPlusC.x * zSquaredPlusC.x) + (zSquaredPlusC.y * zSquaredPlusC.y)) > 4)
-                                return i + 1;
+                            if (!inPass(row, line))
+                                continue;
+                            const auto pixel = static_cast<std::size_t>(range.first + line) * m_size + row;
+
+                            // solid guessing: a pixel between samples of the previous pass that all agree gets their
+                            // count; at the edges of the frame there are fewer samples to agree
+                            if (guessing && stride < 4)
+                            {
+                                const auto spacing = 2 * stride;
+                                const auto firstLine = line - line % spacing;
+                                const auto firstRow = row - row % spacing;
+                                const auto lastLine = firstLine + spacing < lines ? firstLine + spacing : firstLine;
+                                const auto lastRow = firstRow + spacing < m_size ? firstRow + spacing : firstRow;
+                                const auto sample = [&](int sampleLine, int sampleRow) {
+                                    return results.at((range.first + sampleLine) * m_size + sampleRow);
+                                };
+                                const auto count = sample(firstLine, firstRow);
+                                if (sample(firstLine, lastRow) == count && sample(lastLine, firstRow) == count
+                                    && sample(lastLine, lastRow) == count)
+                                {
+                                    results.set(pixel, count);
+                                    ++guessed;
+                                    continue;
+                                }
+                            }
+                            pixels.push_back(pixel);
                         }
-                        return 0;
                     }
-                });
-
-                compute::vector<std::complex<double>> points_compute(points.size());
-                compute::copy(points.begin(), points.end(), points_compute.begin());
-
-                compute::vector<int> results_compute(points_compute.size());
-                compute::transform(points_compute.begin(), points_compute.end(), results_compute.begin(), calculateMandelbrotCompute);
+                }
+                calculatePixels(pixels);
+                if (stride == 1 || !progressive)
+                    continue;
 
-                compute::copy(results_compute.begin(), results_compute.end(), results.begin());
+                const auto previewStart = timer.durationElapsed();
+                auto &preview = context.preview;
+                preview.reset(results.size(), options.maxIterations, settings.hugePages);
+                for (int line = 0; line < m_size; ++line)
+                {
+                    auto source = line;
+                    if (line >= symmetry.mirrored.first && line < symmetry.mirrored.last)
+                        source = symmetry.mirror - line;
+                    const auto &range = source < symmetry.computed[0].last ? symmetry.computed[0] : symmetry.computed[1];
+                    const auto sampleLine = range.first + (source - range.first) / stride * stride;
+                    for (int row = 0; row < m_size; ++row)
+                        preview.set(line * m_size + row, results.at(sampleLine * m_size + row / stride * stride));
+                }
+                QImage image{m_size, m_size, QImage::Format_RGB32};
+                colorize(image, m_renderType, preview, m_size, options.maxIterations);
+                QMetaObject::invokeMethod(this, [this, image, generation] {
+                    if (m_generation != generation)
+                        return;
+                    m_pixmap = QPixmap::fromImage(image);
+                    m_previewShown = true;
+                    update();
+                });
+                if (!firstPreview)
+                    firstPreview = timer.durationElapsed();
+                offClock += timer.durationElapsed() - previewStart;
             }
-            catch (const boost::wrapexcept<boost::compute::program_build_failure> &f)
+        }
+        else
+        {
+            for (int rangeIndex = 0; rangeIndex < 2; ++rangeIndex)
             {
-                std::cout << f.build_log() << std::endl;
-                std::cout << f.what() << std::endl;
-                std::cout << f.error_code() << std::endl;
-                std::cout << f.error_string() << std::endl;
+                const auto &range = symmetry.computed[rangeIndex];
+                if (range.first >= range.last || cancelled())
+                    continue;
+                auto rangeBatch = batch;
+                rangeBatch.first += range.first * m_size;
+                rangeBatch.results = results.data(range.first * m_size);
+                rangeBatch.count = static_cast<std::size_t>(range.last - range.first) * m_size;
+
+                if (m_renderType == RenderType::Gpu)
+                {
+                    const auto gpu = calculateOnGpu(rangeBatch, options, timer, *context.gpu);
+                    offClock += gpu.offClock;
+                    skipped += gpu.skipped;
+                }
+                else if (subdivide)
+                {
+                    const auto stats = calculateSubdivided(kernel.calculate, rangeBatch, range.last - range.first, m_size,
+                                                           m_renderType == RenderType::CpuMultiThread);
+                    subdivision.iterated += stats.iterated;
+                    subdivision.filled += stats.filled;
+                    skipped += stats.skipped;
+                }
+                else
+                {
+                    // CpuMultiThread hands the work items out as settings.partitioning says. Each item checks for
+                    // cancellation first and records what the kernel skipped in it, which also marks it as done.
+                    const auto &tiles = rangeTiles[rangeIndex];
+                    const auto items = rangeItems[rangeIndex];
+                    auto &itemSkipped = context.itemSkipped[rangeIndex];
+                    workItems += items;
+                    reused += static_cast<std::size_t>(std::count_if(itemSkipped.begin(), itemSkipped.end(),
+                                                                     [](std::size_t s) { return s != notDone; }));
+                    const auto calculateItem = [&](std::size_t item) {
+                        if (itemSkipped[item] != notDone || cancelled())
+                            return;
+                        if (tiled)
+                        {
+                            itemSkipped[item] = calculateTile(kernel.calculate, rangeBatch, m_size, tiles[item]);
+                            return;
+                        }
+                        auto lineBatch = rangeBatch;
+                        lineBatch.first += item * m_size;
+                        lineBatch.results = results.data((range.first + item) * m_size);
+                        lineBatch.count = m_size;
+                        itemSkipped[item] = kernel.calculate(lineBatch);
+                    };
+                    if (m_renderType == RenderType::CpuMultiThread)
+                        steals += runPartitioned(settings.partitioning, items, *context.threadPool, calculateItem);
+                    else
+                    {
+                        for (std::size_t item = 0; item < items; ++item)
+                            calculateItem(item);
+                    }
+                    for (const auto itemSkip : itemSkipped)
+                        skipped += itemSkip == notDone ? 0 : itemSkip;
+                }
             }
         }
 
-        const auto time = timer.durationElapsed();
+        if (cancelled())
+        {
+            if (resumable)
+                context.cancelledFrame = frameKey;
+            return;
+        }
+
+        for (auto line = symmetry.mirrored.first; line < symmetry.mirrored.last; ++line)
+            results.copy((symmetry.mirror - line) * m_size, m_size, line * m_size);
+        const auto mirrored = static_cast<std::size_t>(symmetry.mirrored.last - symmetry.mirrored.first) * m_size;
+
+        const auto time = timer.durationElapsed() - offClock;
+        auto precisionText = precisionName(options.precision);
+        if (settings.precision == Precision::Automatic)
+            precisionText += QStringLiteral(" (auto)");
+        auto iterationsText = QString::number(options.maxIterations);
+        if (settings.maxIterations <= 0)
+            iterationsText += QStringLiteral(" (auto)");
+        auto partitioningText = subdivide ? QStringLiteral("subdivision") : partitioningName(settings.partitioning);
+        if (!subdivide && settings.partitioning == Partitioning::WorkStealing)
+            partitioningText += QStringLiteral(", %1 steals").arg(QString::number(steals));
+        auto threadsText =
+            QStringLiteral("%1 threads").arg(QString::number(QThreadPool::globalInstance()->maxThreadCount()));
+        if (usesRenderPool)
+        {
+            const auto &topology = context.threadPool->topology();
+            threadsText = QStringLiteral("%1 threads on %2 cores, %3 NUMA nodes%4")
+                              .arg(QString::number(context.threadPool->threadCount()),
+                                   QString::number(topology.physicalCores()),
+                                   QString::number(topology.numaNodes()),
+                                   context.threadPool->pinned() && topology.detected ? QStringLiteral(", pinned")
+                                                                                     : QString{});
+        }
         QString timeText;
         switch (m_renderType)
         {
         case RenderType::CpuSingleThread:
-            timeText = QStringLiteral("Single-threaded CPU");
+            timeText = QStringLiteral("Single-threaded CPU (%1, %2)")
+                           .arg(QString::fromLatin1(kernel.name), precisionText);
             break;
         case RenderType::CpuMultiThread:
-            timeText = QStringLiteral("Multi-threaded CPU (%1 threads)").arg(QThreadPool::globalInstance()->maxThreadCount());
+            timeText = QStringLiteral("Multi-threaded CPU (%1, %2, %3, %4)")
+                           .arg(threadsText,
+                                partitioningText,
+                                QString::fromLatin1(kernel.name),
+                                precisionText);
+            break;
+        case RenderType::CpuSimd:
+            timeText = QStringLiteral("SIMD CPU (%1, %2 lanes, %3)")
+                           .arg(QString::fromLatin1(kernel.name),
+                                QString::number(kernel.lanes),
+                                precisionText);
             break;
         case RenderType::Gpu:
-            timeText = QString::fromStdString(compute::system::default_device().name());
+            timeText = QStringLiteral("%1 (%2)").arg(QString::fromStdString(compute::system::default_device().name()),
+                                                     precisionText);
             break;
         }
 
-        m_debugLabel->setText(QStringLiteral("%1\n%2x%2 px\n%3 ns\n%4 ms\n%5 s")
-                                  .arg(timeText,
-                                       QString::number(m_size),
-                                       QString::number(time.count()),
-                                       QString::number((double)time.count() / 1000000),
-                                       QString::number((double)time.count() / 1000000000)));
-        m_debugLabel->resize(m_debugLabel->sizeHint());
-
-        for (int i = 0; i < results.size(); ++i)
-        {
-            if (results[i] == 0)
-                painter.setPen(QPen{QColor{0, 0, 0}});
-            else
-            {
-                switch (m_renderType)
-                {
-                case RenderType::CpuSingleThread:
-                    painter.setPen(QPen{QColor{255 - std::min(static_cast<int>(255 / results[i] / 4), 255),
-                                               255 - std::min(static_cast<int>(255 / results[i] / 0.8) + 50, 255),
-                                               255 - std::min(static_cast<int>(255 / results[i] / 0.8) + 50, 255)}});
-                    break;
-                case RenderType::CpuMultiThread:
-                    painter.setPen(QPen{QColor{255 - std::min(static_cast<int>(255 / results[i]/ 0.8) + 50, 255),
-                                               255 - std::min(static_cast<int>(255 / results[i]/ 4) + 50, 255),
-                                               255 - std::min(static_cast<int>(255 / results[i]/ 0.8) + 50, 255)}});
-                    break;
-                case RenderType::Gpu:
-                    painter.setPen(QPen{QColor{255 - std::min(static_cast<int>(255 / results[i] / 0.8) + 50, 255),
-                                               255 - std::min(static_cast<int>(255 / results[i] / 0.8) + 50, 255),
-                                               255 - std::min(static_cast<int>(255 / results[i] / 4) + 50, 255)}});
-                    break;
-                }
-
-            }
-
-            painter.drawPoint(pixels[i]);
-        }
+        QString subdivisionText;
+        if (subdivide)
+            subdivisionText = QStringLiteral("\n%1 pixels iterated, %2 filled")
+                                  .arg(QString::number(subdivision.iterated), QString::number(subdivision.filled));
+        else if (guessing)
+            subdivisionText = QStringLiteral("\n%1 pixels guessed").arg(QString::number(guessed));
+        else if (reused > 0)
+            subdivisionText = QStringLiteral("\n%1 of %2 tiles or lines kept from a cancelled render")
+                                  .arg(QString::number(reused), QString::number(workItems));
+        else if (tiled)
+            subdivisionText = QStringLiteral("\n%1x%1 px tiles").arg(QString::number(settings.tileSize));
+        const auto mirroredText = mirrored > 0 ? QStringLiteral("\n%1 pixels mirrored").arg(QString::number(mirrored))
+                                               : QString{};
+        const auto previewText = firstPreview ? QStringLiteral("\nfirst preview after %1 ms")
+                                                    .arg(QString::number((double)firstPreview->count() / 1000000))
+                                              : QString{};
+        const auto labelText = QStringLiteral("%1\n%2x%2 px, %3 iterations%4\n%5 pixels skipped%6%7%8\n%9 ns\n%10 ms\n%11 s")
+                                   .arg(timeText,
+                                        QString::number(m_size),
+                                        iterationsText,
+                                        options.periodicityCheck  ? QStringLiteral(", periodicity check")
+                                            : options.deferredBailout ? QStringLiteral(", deferred bailout")
+                                                                      : QString{},
+                                        QString::number(skipped),
+                                        mirroredText,
+                                        subdivisionText,
+                                        previewText,
+                                        QString::number(time.count()),
+                                        QString::number((double)time.count() / 1000000),
+                                        QString::number((double)time.count() / 1000000000));
 
-        m_doneRendering = true;
-        emit doneRendering();
-        update();
+        QImage image{m_size, m_size, QImage::Format_RGB32};
+        colorize(image, m_renderType, results, m_size, options.maxIterations);
+        // the label is a widget, so it's only touched on the GUI thread, and only for the current render
+        QMetaObject::invokeMethod(this, [this, image, labelText, generation] {
+            if (m_generation != generation)
+                return;
+            m_debugLabel->setText(labelText);
+            m_debugLabel->resize(m_debugLabel->sizeHint());
+            m_pixmap = QPixmap::fromImage(image);
+            m_doneRendering = true;
+            emit doneRendering();
+            update();
+        });
     });
     emit rendering(renderJob);
     update();
@@ -204,7 +1029,7 @@ void MandelbrotWidget::rerender()
 void MandelbrotWidget::paintEvent(QPaintEvent *)
 {
     QPainter painter(this);
-    if (m_doneRendering)
+    if (m_doneRendering || m_previewShown)
     {
         painter.drawPixmap(0, 0, m_pixmap);
         if (!m_debugLabel->text().isEmpty())
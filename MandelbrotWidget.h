@@ -8,6 +8,15 @@
 #include <QLabel>
 #include <QFuture>
 
+#include "MandelbrotKernel.h"
+#include "Partitioning.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+struct RenderContext;
+
 class MandelbrotWidget : public QWidget
 {
     Q_OBJECT
@@ -17,6 +26,7 @@ public:
     {
         CpuSingleThread,
         CpuMultiThread,
+        CpuSimd,
         Gpu,
     };
 
@@ -24,11 +34,54 @@ public:
     {
         EntireSet,
         LeftSpike,
+        // 1e-24 wide around c = i, which needs double-double
+        SpiralZoom,
+        // 1e-100 wide around c = i, which needs perturbation
+        DeepSpiralZoom,
     };
 
     explicit MandelbrotWidget(RenderType renderType, QWidget *parent = nullptr);
+    ~MandelbrotWidget() override;
 
     void setView(FractalView view);
+    // Automatic picks float, double, double-double or perturbation per frame from the view's pixel spacing. The GPU
+    // renders long double, double-double and perturbation as double.
+    void setPrecision(Precision precision);
+    // 0 picks a cap from the zoom depth of the view, see automaticIterationCap().
+    void setMaxIterations(int maxIterations);
+    // Stop iterating interior points once their orbit turns out to be periodic. Off by default, so benchmarks measure
+    // the plain escape-time loop unless asked otherwise.
+    void setPeriodicityCheck(bool enabled);
+    // Test for escape only every few iterations, see iterateMandelbrotDeferred(). Same results; used by the scalar float,
+    // double and long double CPU kernels and the GPU, and not together with the periodicity check. The label only
+    // mentions it for frames that used it.
+    void setDeferredBailout(bool enabled);
+    // Mariani-Silver subdivision, see calculateSubdivided(). Iterates a fraction of the pixels, but no longer exact:
+    // thin filaments that cross no border get filled over, so off by default. The CPU backends only; the GPU keeps
+    // iterating every pixel.
+    void setSubdivision(bool enabled);
+    // Only for CpuSingleThread and CpuMultiThread.
+    void setCpuKernel(CpuKernel kernel);
+    // Show 1/16 and 1/4 of the samples before the full frame; every pass reuses the samples of the ones before it.
+    // Ignored while subdividing, which already works coarse to fine.
+    void setProgressive(bool enabled);
+    // Solid guessing: iterate every 4th pixel, then fill each pixel in between whose neighbouring samples all agree and
+    // iterate only the rest, in two rounds. Much faster on exterior views, but no longer exact, so off by default.
+    // Ignored while subdividing.
+    void setGuessing(bool enabled);
+    // Render the CPU frames in square tiles of this many pixels a side, see frameTiles(); 0 renders them by lines.
+    // Ignored while subdividing, progressive or guessing, which pick their own pixels.
+    void setTileSize(int tileSize);
+    // How CpuMultiThread hands out its tiles, lines or chunks of pixels to the threads, see runPartitioned(). Subdivision
+    // keeps its own rounds.
+    void setPartitioning(Partitioning partitioning);
+    // Pin the threads of CpuMultiThread to one CPU each, see RenderThreadPool. Only on Linux.
+    void setPinThreads(bool enabled);
+    // Run CpuMultiThread with one thread per physical core instead of one per hardware thread.
+    void setPhysicalCoresOnly(bool enabled);
+    // Back the frame buffers with transparent huge pages where the system offers them, see AlignedBuffer.
+    void setHugePages(bool enabled);
+    // Starts rendering the current settings. A render still running is cancelled, see m_generation.
     void rerender();
 
     bool rendering() const { return !m_doneRendering; }
@@ -44,7 +97,30 @@ private:
     RenderType m_renderType;
     int m_size;
     bool m_doneRendering = false;
+    bool m_previewShown = false;
     QPixmap m_pixmap;
     QLabel *m_debugLabel;
-    FractalView m_view{FractalView::EntireSet};
+    // what the setters change; rerender() hands its render a copy, so a render never mixes the settings of two calls
+    struct Settings
+    {
+        FractalView view{FractalView::EntireSet};
+        Precision precision{Precision::Automatic};
+        int maxIterations = 100;
+        bool periodicityCheck = false;
+        bool deferredBailout = false;
+        bool subdivision = false;
+        CpuKernel cpuKernel{CpuKernel::Simd};
+        bool progressive = false;
+        bool guessing = false;
+        int tileSize = 64;
+        Partitioning partitioning{Partitioning::WorkStealing};
+        bool pinThreads = false;
+        bool physicalCoresOnly = false;
+        bool hugePages = false;
+    };
+    Settings m_settings;
+    // the buffers of the renders, kept from one to the next
+    std::unique_ptr<RenderContext> m_context;
+    // counts rerender() calls; a render whose number is no longer current has been superseded and stops
+    std::atomic<std::uint64_t> m_generation{0};
 };
@@ -0,0 +1,63 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Partitioning.h"
+
+#include "RenderThreadPool.h"
+#include "WorkStealing.h"
+
+#include <algorithm>
+#include <atomic>
+
+std::size_t runPartitioned(Partitioning partitioning, std::size_t count, RenderThreadPool &pool,
+                           const std::function<void(std::size_t)> &work)
+{
+    if (partitioning == Partitioning::WorkStealing)
+        return runWorkStealing(count, pool, work);
+    if (count == 0)
+        return 0;
+    const auto workers = static_cast<std::size_t>(pool.threadCount());
+
+    std::atomic<std::size_t> next{0};
+    switch (partitioning)
+    {
+    case Partitioning::WorkStealing:
+        break;
+    case Partitioning::StaticBlocks:
+        pool.run([&](int worker) {
+            const auto last = count * (worker + 1) / workers;
+            for (auto i = count * worker / workers; i < last; ++i)
+                work(i);
+        });
+        break;
+    case Partitioning::RoundRobin:
+        pool.run([&](int worker) {
+            for (std::size_t i = worker; i < count; i += workers)
+                work(i);
+        });
+        break;
+    case Partitioning::Dynamic:
+        pool.run([&](int) {
+            for (auto i = next.fetch_add(1, std::memory_order_relaxed); i < count;
+                 i = next.fetch_add(1, std::memory_order_relaxed))
+                work(i);
+        });
+        break;
+    case Partitioning::Guided:
+        pool.run([&](int) {
+            auto first = next.load(std::memory_order_relaxed);
+            while (first < count)
+            {
+                const auto chunk = std::max<std::size_t>((count - first) / workers, 1);
+                if (!next.compare_exchange_weak(first, first + chunk, std::memory_order_relaxed))
+                    continue;
+                for (auto i = first; i < first + chunk; ++i)
+                    work(i);
+                first = next.load(std::memory_order_relaxed);
+            }
+        });
+        break;
+    }
+    return 0;
+}
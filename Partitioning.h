@@ -0,0 +1,31 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+class RenderThreadPool;
+
+// How the work items of a multi-threaded frame, tiles or lines, are handed out to the threads.
+enum class Partitioning
+{
+    // see runWorkStealing()
+    WorkStealing,
+    // every thread gets one contiguous block of items up front
+    StaticBlocks,
+    // thread i gets items i, i + threads, i + 2 * threads and so on; interleaved lines when rendering by lines
+    RoundRobin,
+    // threads take the next item from a shared counter, one at a time
+    Dynamic,
+    // like Dynamic, but each take is the remaining items divided by the threads, so chunks shrink towards the end
+    Guided,
+};
+
+// Calls work for every index in [0, count) on the threads of pool, handed out as partitioning says, and returns once all
+// calls are done. Returns how many steals there were, which is only
+// ever non-zero for Partitioning::WorkStealing.
+std::size_t runPartitioned(Partitioning partitioning, std::size_t count, RenderThreadPool &pool,
+                           const std::function<void(std::size_t)> &work);
@@ -0,0 +1,80 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Perturbation.h"
+
+#include <boost/multiprecision/cpp_bin_float.hpp>
+
+#include <cmath>
+
+namespace
+{
+    using HighPrecision =
+        boost::multiprecision::number<boost::multiprecision::cpp_bin_float<128>, boost::multiprecision::et_off>;
+
+    HighPrecision highPrecision(const std::string &decimal, const DoubleDouble &fallback)
+    {
+        if (decimal.empty())
+            return HighPrecision{fallback.hi} + HighPrecision{fallback.lo};
+        return HighPrecision{decimal};
+    }
+
+    // The series only replaces iterations while its cubic term stays this small next to the linear one, so the terms it
+    // drops are far below a pixel.
+    constexpr double seriesTolerance = 1e-12;
+} // namespace
+
+ReferenceOrbit::ReferenceOrbit(const Viewport &viewport, int maxIterations)
+{
+    const auto cx = highPrecision(viewport.preciseCenterX, viewport.centerX);
+    const auto cy = highPrecision(viewport.preciseCenterY, viewport.centerY);
+
+    // Z_0 up to Z_{maxIterations + 1}, since the kernels count iterations from Z_1 = c. The reference stops where it
+    // escapes; points still running by then rebase onto its start.
+    m_orbit.reserve(maxIterations + 2);
+    m_orbit.push_back({0, 0});
+    HighPrecision x = 0;
+    HighPrecision y = 0;
+    for (int i = 0; i <= maxIterations && std::norm(m_orbit.back()) <= 4; ++i)
+    {
+        const auto xy = x * y;
+        x = x * x - y * y + cx;
+        y = xy + xy + cy;
+        m_orbit.push_back({static_cast<double>(x), static_cast<double>(y)});
+    }
+
+    // Coefficients of delta_n = A_n d + B_n d^2 + C_n d^3 for a point at offset d, with A_n, B_n and C_n scaled by
+    // powers of the radius so they stay in range however deep the view is:
+    //   a' = 2 Z a + r, b' = 2 Z b + a^2, c' = 2 Z c + 2 a b
+    // The series stops before its truncation error matters or any point could escape.
+    const auto radius = viewport.width / 2 * std::sqrt(2.0);
+    std::complex<double> a;
+    std::complex<double> b;
+    std::complex<double> c;
+    int n = 0;
+    for (; n + 1 < static_cast<int>(m_orbit.size()); ++n)
+    {
+        const auto twoZ = 2.0 * m_orbit[n];
+        const auto nextA = twoZ * a + radius;
+        const auto nextB = twoZ * b + a * a;
+        const auto nextC = twoZ * c + 2.0 * a * b;
+        if (std::abs(nextC) > seriesTolerance * std::abs(nextA)
+            || std::abs(m_orbit[n + 1]) + std::abs(nextA) + std::abs(nextB) + std::abs(nextC) >= 2)
+            break;
+        a = nextA;
+        b = nextB;
+        c = nextC;
+    }
+
+    m_reference.orbit = reinterpret_cast<const double *>(m_orbit.data());
+    m_reference.length = static_cast<int>(m_orbit.size());
+    m_reference.seriesIterations = n;
+    m_reference.seriesRadius = radius;
+    m_reference.a[0] = a.real();
+    m_reference.a[1] = a.imag();
+    m_reference.b[0] = b.real();
+    m_reference.b[1] = b.imag();
+    m_reference.c[0] = c.real();
+    m_reference.c[1] = c.imag();
+}
@@ -0,0 +1,29 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "MandelbrotKernel.h"
+#include "Viewport.h"
+
+#include <complex>
+#include <vector>
+
+// The orbit of a view's center, computed with Boost.Multiprecision at about 128 significant digits, which is enough for
+// views down to a width of roughly 1e-120. It also fits the series approximation for the view, so perturbation kernels
+// can skip the iterations where all of its points still move together.
+class ReferenceOrbit
+{
+public:
+    ReferenceOrbit(const Viewport &viewport, int maxIterations);
+    ReferenceOrbit(const ReferenceOrbit &) = delete;
+    ReferenceOrbit &operator=(const ReferenceOrbit &) = delete;
+
+    // points into this object, which must outlive any batch using it
+    const PerturbationReference &reference() const { return m_reference; }
+
+private:
+    std::vector<std::complex<double>> m_orbit;
+    PerturbationReference m_reference;
+};
@@ -0,0 +1,74 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "RenderThreadPool.h"
+
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+RenderThreadPool::RenderThreadPool(bool pinned, bool physicalCoresOnly)
+    : m_topology{detectCpuTopology()},
+      m_pinned{pinned},
+      m_physicalCoresOnly{physicalCoresOnly}
+{
+    const auto cpus = workerCpus(m_topology, physicalCoresOnly);
+    m_threads.reserve(cpus.size());
+    for (std::size_t i = 0; i < cpus.size(); ++i)
+        m_threads.emplace_back(&RenderThreadPool::threadMain, this, static_cast<int>(i), cpus[i].id);
+}
+
+RenderThreadPool::~RenderThreadPool()
+{
+    {
+        std::lock_guard lock{m_mutex};
+        m_quit = true;
+    }
+    m_started.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+void RenderThreadPool::run(const std::function<void(int)> &worker)
+{
+    std::unique_lock lock{m_mutex};
+    m_worker = &worker;
+    m_running = threadCount();
+    ++m_generation;
+    m_started.notify_all();
+    m_finished.wait(lock, [this] { return m_running == 0; });
+    m_worker = nullptr;
+}
+
+void RenderThreadPool::threadMain(int index, int cpu)
+{
+#if defined(__linux__)
+    if (m_pinned && m_topology.detected)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    }
+#else
+    (void)cpu;
+#endif
+
+    std::uint64_t seen = 0;
+    std::unique_lock lock{m_mutex};
+    for (;;)
+    {
+        m_started.wait(lock, [&] { return m_quit || m_generation != seen; });
+        if (m_quit)
+            return;
+        seen = m_generation;
+        const auto &worker = *m_worker;
+        lock.unlock();
+        worker(index);
+        lock.lock();
+        if (--m_running == 0)
+            m_finished.notify_one();
+    }
+}
@@ -0,0 +1,53 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "CpuTopology.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The threads of the multi-threaded renderer: one per CPU of workerCpus(), started once and kept waiting between
+// frames. Thread i can be pinned to the i-th of those CPUs, so it stays on its core and its NUMA node for the whole
+// benchmark; QThreadPool has no say over where its threads run.
+class RenderThreadPool
+{
+public:
+    RenderThreadPool(bool pinned, bool physicalCoresOnly);
+    RenderThreadPool(const RenderThreadPool &) = delete;
+    RenderThreadPool &operator=(const RenderThreadPool &) = delete;
+    ~RenderThreadPool();
+
+    int threadCount() const { return static_cast<int>(m_threads.size()); }
+    // as asked for; threads are only pinned with a topology from sysfs, see CpuTopology::detected
+    bool pinned() const { return m_pinned; }
+    bool physicalCoresOnly() const { return m_physicalCoresOnly; }
+    const CpuTopology &topology() const { return m_topology; }
+
+    // Calls worker(i) on thread i for every thread and returns once all of them are done. One run() at a time.
+    void run(const std::function<void(int)> &worker);
+
+private:
+    void threadMain(int index, int cpu);
+
+    CpuTopology m_topology;
+    bool m_pinned = false;
+    bool m_physicalCoresOnly = false;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_mutex;
+    std::condition_variable m_started;
+    std::condition_variable m_finished;
+    const std::function<void(int)> *m_worker = nullptr;
+    // counts run() calls, so a thread knows whether it has seen the current one
+    std::uint64_t m_generation = 0;
+    int m_running = 0;
+    bool m_quit = false;
+};
@@ -0,0 +1,491 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+// This header is included by translation units that are compiled with instruction set flags (-mavx2 etc.). Don't use
+// anything from the standard library in here: inline functions instantiated in those units could be picked by the
+// linker for the whole program and crash on older CPUs.
+
+#include "MandelbrotKernel.h"
+
+// Same closed-form test as isInMainCardioidOrBulb(), for a register of points.
+template<typename V>
+typename V::Mask interiorLanes(typename V::Vec cx, typename V::Vec cy)
+{
+    using Real = typename V::Real;
+    const auto one = V::broadcast(1);
+    const auto quarter = V::broadcast(Real(0.25));
+    const auto sixteenth = V::broadcast(Real(0.0625));
+    const auto yy = V::mul(cy, cy);
+    const auto xq = V::sub(cx, quarter);
+    const auto q = V::add(V::mul(xq, xq), yy);
+    const auto x1 = V::add(cx, one);
+    return V::either(V::lessEqual(V::mul(q, V::add(q, xq)), V::mul(quarter, yy)),
+                     V::lessEqual(V::add(V::mul(x1, x1), yy), sixteenth));
+}
+
+// The offsets from the center of the lanes starting at first, the same as pointOffset(), which can't be called from
+// here. Lanes past the end of the batch get 0.
+template<typename V>
+void laneOffsets(const PointBatch &batch, std::size_t first, double *real, double *imag)
+{
+    const auto half = batch.size / 2.0;
+    for (int lane = 0; lane < V::lanes; ++lane)
+    {
+        const auto i = first + lane;
+        if (i >= batch.count)
+        {
+            real[lane] = 0;
+            imag[lane] = 0;
+            continue;
+        }
+        const auto pixel = batch.first + (batch.pixels ? batch.pixels[i] : i);
+        real[lane] = (static_cast<int>(pixel % batch.size) - half) * batch.spacing;
+        imag[lane] = (static_cast<int>(pixel / batch.size) - half) * batch.spacing;
+    }
+}
+
+// Writes the results of the lanes starting at first, and returns how many of them were rejected without iterating.
+template<typename V, typename Count>
+std::size_t storeLaneResults(Count *results,
+                             std::size_t first,
+                             std::size_t count,
+                             typename V::Vec iterations,
+                             typename V::Mask bounded,
+                             typename V::Mask rejected)
+{
+    using Real = typename V::Real;
+    constexpr int lanes = V::lanes;
+
+    alignas(64) Real counts[lanes];
+    V::store(counts, iterations);
+    const auto boundedBits = V::bits(bounded);
+    const auto rejectedBits = V::bits(rejected);
+    std::size_t skipped = 0;
+    for (int lane = 0; lane < lanes && first + lane < count; ++lane)
+    {
+        const auto n = static_cast<int>(counts[lane]);
+        if ((rejectedBits >> lane) & 1)
+        {
+            results[first + lane] = 0;
+            ++skipped;
+        }
+        else if ((boundedBits >> lane) & 1)
+            results[first + lane] = 0;
+        else
+            // lanes that never started iterating were outside the radius 2 circle to begin with
+            results[first + lane] = static_cast<Count>(n == 0 ? 1 : n);
+    }
+    return skipped;
+}
+
+// Escape-time loop over the lanes of a SIMD register. V describes the register type and the few operations the loop
+// needs; see SimdKernelsAvx2.cpp for an example. Each lane keeps its own iteration counter, which stops counting as
+// soon as the lane escapes, so the results match iterateMandelbrot<V::Real, MaxIter, CheckPeriodicity>() for every
+// point. Lanes whose orbit turns out to be periodic stop early as well.
+template<typename V, int MaxIter, bool CheckPeriodicity, typename Count = FixedCount<MaxIter>>
+std::size_t calculateMandelbrotLanes(const PointBatch &batch)
+{
+    using Real = typename V::Real;
+    constexpr int lanes = V::lanes;
+
+    const auto count = batch.count;
+    const auto results = static_cast<Count *>(batch.results);
+    const auto maxIterations = MaxIter == runtimeIterationCap ? batch.maxIterations : MaxIter;
+    const auto zero = V::broadcast(0);
+    const auto one = V::broadcast(1);
+    const auto four = V::broadcast(4);
+    const auto epsilon = V::broadcast(periodicityEpsilon<Real>);
+
+    std::size_t skipped = 0;
+    for (std::size_t first = 0; first < count; first += lanes)
+    {
+        // the last batch is padded with the origin, which never escapes and is discarded below; like coordinate(),
+        // the center and offset are added in double and rounded to Real once
+        alignas(64) double offsetX[lanes];
+        alignas(64) double offsetY[lanes];
+        laneOffsets<V>(batch, first, offsetX, offsetY);
+        alignas(64) Real real[lanes];
+        alignas(64) Real imag[lanes];
+        for (int lane = 0; lane < lanes; ++lane)
+        {
+            const auto i = first + lane;
+            real[lane] = i < count ? static_cast<Real>(batch.centerX.hi + offsetX[lane] + batch.centerX.lo) : Real{0};
+            imag[lane] = i < count ? static_cast<Real>(batch.centerY.hi + offsetY[lane] + batch.centerY.lo) : Real{0};
+        }
+
+        const auto cx = V::load(real);
+        const auto cy = V::load(imag);
+        auto x = cx;
+        auto y = cy;
+        auto iterations = zero;
+
+        // points in the main cardioid or period-2 bulb start out finished
+        const auto interior = interiorLanes<V>(cx, cy);
+        const auto inRadius = V::lessEqual(V::add(V::mul(cx, cx), V::mul(cy, cy)), four);
+        auto active = V::bothNot(inRadius, interior);
+        auto periodic = V::none();
+        auto savedX = x;
+        auto savedY = y;
+        int checkpoint = 1;
+        for (int i = 0; i < maxIterations && V::any(active); ++i)
+        {
+            const auto xx = V::mul(x, x);
+            const auto yy = V::mul(y, y);
+            const auto xy = V::mul(x, y);
+            x = V::select(active, V::add(V::sub(xx, yy), cx), x);
+            y = V::select(active, V::add(V::add(xy, xy), cy), y);
+            iterations = V::addWhere(active, iterations, one);
+            active = V::both(active, V::lessEqual(V::add(V::mul(x, x), V::mul(y, y)), four));
+
+            if constexpr (CheckPeriodicity)
+            {
+                const auto dx = V::sub(x, savedX);
+                const auto dy = V::sub(y, savedY);
+                const auto returned = V::both(active, V::lessEqual(V::add(V::mul(dx, dx), V::mul(dy, dy)), epsilon));
+                periodic = V::either(periodic, returned);
+                active = V::bothNot(active, returned);
+                if (i + 1 == checkpoint)
+                {
+                    savedX = x;
+                    savedY = y;
+                    checkpoint *= 2;
+                }
+            }
+        }
+
+        skipped += storeLaneResults<V>(results, first, count, iterations, V::either(active, periodic),
+                                       V::both(inRadius, interior));
+    }
+    return skipped;
+}
+
+// Double-double arithmetic on registers of doubles: each value is a pair of registers holding the unevaluated sum
+// hi + lo. The error-free transformations need every operation rounded exactly as written, which is why the kernel
+// units are compiled with -ffp-contract=off.
+template<typename V>
+struct DoubleDoubleLanes
+{
+    using Vec = typename V::Vec;
+
+    Vec hi;
+    Vec lo;
+
+    // s + e == a + b exactly
+    static DoubleDoubleLanes twoSum(Vec a, Vec b)
+    {
+        const auto s = V::add(a, b);
+        const auto bb = V::sub(s, a);
+        const auto e = V::add(V::sub(a, V::sub(s, bb)), V::sub(b, bb));
+        return {s, e};
+    }
+
+    // same as twoSum(), but only valid when |a| >= |b|
+    static DoubleDoubleLanes quickTwoSum(Vec a, Vec b)
+    {
+        const auto s = V::add(a, b);
+        return {s, V::sub(b, V::sub(s, a))};
+    }
+
+    // p + e == a * b exactly, with a fused multiply-subtract if there is one and Dekker's splitting otherwise
+    static DoubleDoubleLanes twoProduct(Vec a, Vec b)
+    {
+        const auto p = V::mul(a, b);
+        if constexpr (V::hasFma)
+            return {p, V::fms(a, b, p)};
+        else
+        {
+            const auto splitter = V::broadcast(134217729.0); // 2^27 + 1
+            const auto ta = V::mul(splitter, a);
+            const auto ahi = V::sub(ta, V::sub(ta, a));
+            const auto alo = V::sub(a, ahi);
+            const auto tb = V::mul(splitter, b);
+            const auto bhi = V::sub(tb, V::sub(tb, b));
+            const auto blo = V::sub(b, bhi);
+            const auto e = V::add(V::add(V::add(V::sub(V::mul(ahi, bhi), p), V::mul(ahi, blo)), V::mul(alo, bhi)),
+                                  V::mul(alo, blo));
+            return {p, e};
+        }
+    }
+
+    static DoubleDoubleLanes add(DoubleDoubleLanes a, DoubleDoubleLanes b)
+    {
+        auto s = twoSum(a.hi, b.hi);
+        const auto t = twoSum(a.lo, b.lo);
+        s = quickTwoSum(s.hi, V::add(s.lo, t.hi));
+        return quickTwoSum(s.hi, V::add(s.lo, t.lo));
+    }
+
+    static DoubleDoubleLanes negate(DoubleDoubleLanes a)
+    {
+        const auto zero = V::broadcast(0);
+        return {V::sub(zero, a.hi), V::sub(zero, a.lo)};
+    }
+
+    static DoubleDoubleLanes mul(DoubleDoubleLanes a, DoubleDoubleLanes b)
+    {
+        const auto p = twoProduct(a.hi, b.hi);
+        return quickTwoSum(p.hi, V::add(p.lo, V::add(V::mul(a.hi, b.lo), V::mul(a.lo, b.hi))));
+    }
+
+    // scaling by two is exact
+    static DoubleDoubleLanes twice(DoubleDoubleLanes a) { return {V::add(a.hi, a.hi), V::add(a.lo, a.lo)}; }
+
+    static DoubleDoubleLanes select(typename V::Mask m, DoubleDoubleLanes a, DoubleDoubleLanes b)
+    {
+        return {V::select(m, a.hi, b.hi), V::select(m, a.lo, b.lo)};
+    }
+};
+
+// Double-double counterpart of calculateMandelbrotLanes(), for views too deep for double to tell neighbouring pixels
+// apart. V must have double lanes and provide hasFma (and fms() if it's true). Escape, interior and periodicity tests
+// only look at the hi parts: they compare against constants, so the lo parts can't change the outcome by more than
+// a rounding error.
+template<typename V, int MaxIter, bool CheckPeriodicity, typename Count = FixedCount<MaxIter>>
+std::size_t calculateMandelbrotLanesDoubleDouble(const PointBatch &batch)
+{
+    using DD = DoubleDoubleLanes<V>;
+    constexpr int lanes = V::lanes;
+
+    const auto count = batch.count;
+    const auto results = static_cast<Count *>(batch.results);
+    const auto maxIterations = MaxIter == runtimeIterationCap ? batch.maxIterations : MaxIter;
+    const auto zero = V::broadcast(0);
+    const auto one = V::broadcast(1);
+    const auto four = V::broadcast(4);
+    const auto epsilon = V::broadcast(doubleDoublePeriodicityEpsilon);
+    const DD centerX{V::broadcast(batch.centerX.hi), V::broadcast(batch.centerX.lo)};
+    const DD centerY{V::broadcast(batch.centerY.hi), V::broadcast(batch.centerY.lo)};
+
+    std::size_t skipped = 0;
+    for (std::size_t first = 0; first < count; first += lanes)
+    {
+        // the last batch is padded with the center, and discarded below
+        alignas(64) double real[lanes];
+        alignas(64) double imag[lanes];
+        laneOffsets<V>(batch, first, real, imag);
+
+        const auto cx = DD::add(centerX, {V::load(real), zero});
+        const auto cy = DD::add(centerY, {V::load(imag), zero});
+        auto x = cx;
+        auto y = cy;
+        auto iterations = zero;
+
+        const auto interior = interiorLanes<V>(cx.hi, cy.hi);
+        const auto inRadius = V::lessEqual(V::add(V::mul(cx.hi, cx.hi), V::mul(cy.hi, cy.hi)), four);
+        auto active = V::bothNot(inRadius, interior);
+        auto periodic = V::none();
+        auto savedX = x;
+        auto savedY = y;
+        int checkpoint = 1;
+        for (int i = 0; i < maxIterations && V::any(active); ++i)
+        {
+            const auto xx = DD::mul(x, x);
+            const auto yy = DD::mul(y, y);
+            const auto xy = DD::mul(x, y);
+            x = DD::select(active, DD::add(DD::add(xx, DD::negate(yy)), cx), x);
+            y = DD::select(active, DD::add(DD::twice(xy), cy), y);
+            iterations = V::addWhere(active, iterations, one);
+            active = V::both(active, V::lessEqual(V::add(V::mul(x.hi, x.hi), V::mul(y.hi, y.hi)), four));
+
+            if constexpr (CheckPeriodicity)
+            {
+                const auto dx = DD::add(x, DD::negate(savedX)).hi;
+                const auto dy = DD::add(y, DD::negate(savedY)).hi;
+                const auto returned = V::both(active, V::lessEqual(V::add(V::mul(dx, dx), V::mul(dy, dy)), epsilon));
+                periodic = V::either(periodic, returned);
+                active = V::bothNot(active, returned);
+                if (i + 1 == checkpoint)
+                {
+                    savedX = x;
+                    savedY = y;
+                    checkpoint *= 2;
+                }
+            }
+        }
+
+        skipped += storeLaneResults<V>(results, first, count, iterations, V::either(active, periodic),
+                                       V::both(inRadius, interior));
+    }
+    return skipped;
+}
+
+// Perturbation counterpart of calculateMandelbrotLanes(), for views too deep even for double-double. Each lane iterates
+// the difference delta between its point and batch.reference in double precision, which only has to resolve the
+// neighbourhood of the reference rather than the whole plane:
+//   delta' = (2 Z + delta) delta + offset
+// Lanes start where the reference's series approximation leaves off. When a lane's orbit gets closer to the origin than
+// its delta, or the reference runs out, it rebases onto the start of the reference orbit (Z_0 = 0), which keeps delta
+// small and avoids the glitches of classic perturbation. V must have double lanes. There is no cardioid test or
+// periodicity check: neither can be decided from double coordinates this deep.
+template<typename V, int MaxIter, typename Count = FixedCount<MaxIter>>
+std::size_t calculateMandelbrotLanesPerturbed(const PointBatch &batch)
+{
+    constexpr int lanes = V::lanes;
+
+    const auto &reference = *batch.reference;
+    const auto count = batch.count;
+    const auto results = static_cast<Count *>(batch.results);
+    const auto maxIterations = MaxIter == runtimeIterationCap ? batch.maxIterations : MaxIter;
+    const auto zero = V::broadcast(0);
+    const auto one = V::broadcast(1);
+    const auto four = V::broadcast(4);
+    const auto last = V::broadcast(reference.length - 1);
+    const auto start = reference.seriesIterations;
+    const auto scale = V::broadcast(1 / reference.seriesRadius);
+
+    for (std::size_t first = 0; first < count; first += lanes)
+    {
+        // the last batch is padded with the reference itself, and discarded below
+        alignas(64) double real[lanes];
+        alignas(64) double imag[lanes];
+        laneOffsets<V>(batch, first, real, imag);
+        const auto cx = V::load(real);
+        const auto cy = V::load(imag);
+
+        // delta after the skipped iterations, ((c u + b) u + a) u
+        const auto ux = V::mul(cx, scale);
+        const auto uy = V::mul(cy, scale);
+        auto dx = V::broadcast(reference.c[0]);
+        auto dy = V::broadcast(reference.c[1]);
+        const auto multiplyAdd = [&](const double *coefficient) {
+            const auto px = V::add(V::sub(V::mul(dx, ux), V::mul(dy, uy)), V::broadcast(coefficient[0]));
+            dy = V::add(V::add(V::mul(dx, uy), V::mul(dy, ux)), V::broadcast(coefficient[1]));
+            dx = px;
+        };
+        multiplyAdd(reference.b);
+        multiplyAdd(reference.a);
+        const double noCoefficient[2] = {0, 0};
+        multiplyAdd(noCoefficient);
+
+        auto index = V::broadcast(start);
+        auto zx = V::broadcast(reference.orbit[2 * start]);
+        auto zy = V::broadcast(reference.orbit[2 * start + 1]);
+        // the other kernels start from z_1 = c and count from there, so z_n is iteration n - 1
+        auto iterations = V::broadcast(start - 1);
+        const auto x0 = V::add(zx, dx);
+        const auto y0 = V::add(zy, dy);
+        auto active = V::lessEqual(V::add(V::mul(x0, x0), V::mul(y0, y0)), four);
+        for (int i = start - 1; i < maxIterations && V::any(active); ++i)
+        {
+            const auto tx = V::add(V::add(zx, zx), dx);
+            const auto ty = V::add(V::add(zy, zy), dy);
+            const auto nextX = V::add(V::sub(V::mul(tx, dx), V::mul(ty, dy)), cx);
+            const auto nextY = V::add(V::add(V::mul(tx, dy), V::mul(ty, dx)), cy);
+            dx = V::select(active, nextX, dx);
+            dy = V::select(active, nextY, dy);
+            index = V::addWhere(active, index, one);
+            iterations = V::addWhere(active, iterations, one);
+
+            // every lane may be at a different point of the reference orbit after rebasing
+            alignas(64) double indices[lanes];
+            alignas(64) double referenceX[lanes];
+            alignas(64) double referenceY[lanes];
+            V::store(indices, index);
+            for (int lane = 0; lane < lanes; ++lane)
+            {
+                const auto n = static_cast<int>(indices[lane]);
+                referenceX[lane] = reference.orbit[2 * n];
+                referenceY[lane] = reference.orbit[2 * n + 1];
+            }
+            zx = V::load(referenceX);
+            zy = V::load(referenceY);
+
+            const auto x = V::add(zx, dx);
+            const auto y = V::add(zy, dy);
+            const auto magnitude = V::add(V::mul(x, x), V::mul(y, y));
+            active = V::both(active, V::lessEqual(magnitude, four));
+
+            const auto deltaMagnitude = V::add(V::mul(dx, dx), V::mul(dy, dy));
+            const auto rebase =
+                V::both(active, V::either(V::lessEqual(magnitude, deltaMagnitude), V::lessEqual(last, index)));
+            dx = V::select(rebase, x, dx);
+            dy = V::select(rebase, y, dy);
+            index = V::select(rebase, zero, index);
+            zx = V::select(rebase, zero, zx);
+            zy = V::select(rebase, zero, zy);
+        }
+
+        storeLaneResults<V>(results, first, count, iterations, active, V::none());
+    }
+    return 0;
+}
+
+template<typename V, bool CheckPeriodicity>
+MandelbrotBatchKernel laneKernel(int maxIterations)
+{
+    switch (maxIterations)
+    {
+    case 100:
+        return calculateMandelbrotLanes<V, 100, CheckPeriodicity>;
+    case 256:
+        return calculateMandelbrotLanes<V, 256, CheckPeriodicity>;
+    case 1000:
+        return calculateMandelbrotLanes<V, 1000, CheckPeriodicity>;
+    case 4096:
+        return calculateMandelbrotLanes<V, 4096, CheckPeriodicity>;
+    default:
+        return selectCountType(maxIterations, [](auto count) -> MandelbrotBatchKernel {
+            return calculateMandelbrotLanes<V, runtimeIterationCap, CheckPeriodicity, decltype(count)>;
+        });
+    }
+}
+
+// Picks the instantiation for options.maxIterations.
+template<typename V>
+MandelbrotBatchKernel laneKernel(const KernelOptions &options)
+{
+    return options.periodicityCheck ? laneKernel<V, true>(options.maxIterations)
+                                    : laneKernel<V, false>(options.maxIterations);
+}
+
+template<typename V, bool CheckPeriodicity>
+MandelbrotBatchKernel doubleDoubleLaneKernel(int maxIterations)
+{
+    switch (maxIterations)
+    {
+    case 100:
+        return calculateMandelbrotLanesDoubleDouble<V, 100, CheckPeriodicity>;
+    case 256:
+        return calculateMandelbrotLanesDoubleDouble<V, 256, CheckPeriodicity>;
+    case 1000:
+        return calculateMandelbrotLanesDoubleDouble<V, 1000, CheckPeriodicity>;
+    case 4096:
+        return calculateMandelbrotLanesDoubleDouble<V, 4096, CheckPeriodicity>;
+    default:
+        return selectCountType(maxIterations, [](auto count) -> MandelbrotBatchKernel {
+            return calculateMandelbrotLanesDoubleDouble<V, runtimeIterationCap, CheckPeriodicity, decltype(count)>;
+        });
+    }
+}
+
+// Picks the double-double instantiation for options.maxIterations.
+template<typename V>
+MandelbrotBatchKernel doubleDoubleLaneKernel(const KernelOptions &options)
+{
+    return options.periodicityCheck ? doubleDoubleLaneKernel<V, true>(options.maxIterations)
+                                    : doubleDoubleLaneKernel<V, false>(options.maxIterations);
+}
+
+// Picks the perturbation instantiation for options.maxIterations.
+template<typename V>
+MandelbrotBatchKernel perturbationLaneKernel(const KernelOptions &options)
+{
+    switch (options.maxIterations)
+    {
+    case 100:
+        return calculateMandelbrotLanesPerturbed<V, 100>;
+    case 256:
+        return calculateMandelbrotLanesPerturbed<V, 256>;
+    case 1000:
+        return calculateMandelbrotLanesPerturbed<V, 1000>;
+    case 4096:
+        return calculateMandelbrotLanesPerturbed<V, 4096>;
+    default:
+        return selectCountType(options.maxIterations, [](auto count) -> MandelbrotBatchKernel {
+            return calculateMandelbrotLanesPerturbed<V, runtimeIterationCap, decltype(count)>;
+        });
+    }
+}
@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SimdKernelImpl.h"
+#include "SimdKernels.h"
+
+namespace
+{
+    // One double per "register", so the double-double and perturbation lane kernels also work without any vector
+    // instructions.
+    struct ScalarDouble
+    {
+        using Real = double;
+        using Vec = double;
+        using Mask = bool;
+        static constexpr int lanes = 1;
+        static constexpr bool hasFma = false;
+
+        static Vec load(const double *p) { return *p; }
+        static void store(double *p, Vec v) { *p = v; }
+        static Vec broadcast(double v) { return v; }
+        static Vec add(Vec a, Vec b) { return a + b; }
+        static Vec sub(Vec a, Vec b) { return a - b; }
+        static Vec mul(Vec a, Vec b) { return a * b; }
+        static Mask none() { return false; }
+        static Mask lessEqual(Vec a, Vec b) { return a <= b; }
+        static Mask both(Mask a, Mask b) { return a && b; }
+        static Mask either(Mask a, Mask b) { return a || b; }
+        static Mask bothNot(Mask a, Mask b) { return a && !b; }
+        static bool any(Mask m) { return m; }
+        static int bits(Mask m) { return m; }
+        static Vec select(Mask m, Vec a, Vec b) { return m ? a : b; }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return m ? a + b : a; }
+    };
+
+    SimdKernel scalarSimdKernel(const KernelOptions &options)
+    {
+        const auto name = simdLevelName(SimdLevel::Scalar);
+        const auto deferred = options.deferredBailout && !options.periodicityCheck;
+        switch (options.precision)
+        {
+        case Precision::Single:
+            return {SimdLevel::Scalar, name, 1, scalarKernel<float>(options), deferred};
+        case Precision::Double:
+        case Precision::Automatic:
+            return {SimdLevel::Scalar, name, 1, scalarKernel<double>(options), deferred};
+        case Precision::DoubleDouble:
+            return {SimdLevel::Scalar, name, 1, doubleDoubleLaneKernel<ScalarDouble>(options)};
+        case Precision::Perturbation:
+            return {SimdLevel::Scalar, name, 1, perturbationLaneKernel<ScalarDouble>(options)};
+        case Precision::Extended:
+            break;
+        }
+        return {SimdLevel::Scalar, name, 1, scalarKernel<long double>(options), deferred};
+    }
+
+    // Double-double and perturbation have no interleaved variant. Neither has long double: on x87 the chains of four
+    // points don't fit into the register stack, and the spilling makes it about twice as slow as one point at a time.
+    SimdKernel interleavedSimdKernel(const KernelOptions &options)
+    {
+        const auto name = "interleaved scalar";
+        switch (options.precision)
+        {
+        case Precision::Single:
+            return {SimdLevel::Scalar, name, interleavedPoints, interleavedKernel<float>(options)};
+        case Precision::Double:
+        case Precision::Automatic:
+            return {SimdLevel::Scalar, name, interleavedPoints, interleavedKernel<double>(options)};
+        case Precision::Extended:
+        case Precision::DoubleDouble:
+        case Precision::Perturbation:
+            break;
+        }
+        return scalarSimdKernel(options);
+    }
+} // namespace
+
+SimdKernel simdKernel(const KernelOptions &options)
+{
+    static const auto level = detectSimdLevel();
+
+    if (options.precision == Precision::Extended)
+        return scalarSimdKernel(options);
+
+    // float lanes are half as wide, so twice as many fit into a register; double-double and perturbation
+    // work on registers of doubles
+    const auto lanesPer128Bits = options.precision == Precision::Single ? 4 : 2;
+    switch (level)
+    {
+#if defined(MANDELBROT_X86_KERNELS)
+    case SimdLevel::Avx512:
+        return {level, simdLevelName(level), 4 * lanesPer128Bits, avx512Kernel(options)};
+    case SimdLevel::Avx2:
+        return {level, simdLevelName(level), 2 * lanesPer128Bits, avx2Kernel(options)};
+    case SimdLevel::Sse2:
+        return {level, simdLevelName(level), lanesPer128Bits, sse2Kernel(options)};
+#endif
+    default:
+        return scalarSimdKernel(options);
+    }
+}
+
+SimdKernel cpuKernel(CpuKernel kernel, const KernelOptions &options)
+{
+    switch (kernel)
+    {
+    case CpuKernel::Interleaved:
+        return interleavedSimdKernel(options);
+    case CpuKernel::Scalar:
+        return scalarSimdKernel(options);
+    case CpuKernel::Simd:
+        break;
+    }
+    return simdKernel(options);
+}
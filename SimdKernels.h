@@ -0,0 +1,35 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "CpuFeatures.h"
+#include "MandelbrotKernel.h"
+
+struct SimdKernel
+{
+    SimdLevel level;
+    const char *name;
+    int lanes;
+    MandelbrotBatchKernel calculate;
+    // whether calculate tests for escape every few iterations as KernelOptions::deferredBailout asked; only the scalar
+    // float, double and long double kernels do
+    bool deferredBailout = false;
+};
+
+// The widest kernel the running CPU supports for options, according to detectSimdLevel(). The CPU is only queried once,
+// so one binary uses the full vector width on every CPU generation it runs on. Unless options.maxIterations is one of
+// iterationCaps, the kernel reads the cap from PointBatch::maxIterations. Extended precision has no vector registers
+// and always uses the scalar kernel; double-double and perturbation run on double lanes. Perturbation kernels need
+// PointBatch::reference, see ReferenceOrbit.
+SimdKernel simdKernel(const KernelOptions &options);
+
+// simdKernel() for CpuKernel::Simd, otherwise the portable kernel of that kind, which runs on any CPU.
+SimdKernel cpuKernel(CpuKernel kernel, const KernelOptions &options);
+
+// Per-instruction-set kernel selection. These are compiled with the matching target flags and the kernels they return
+// must only be called on CPUs that support them; use simdKernel() instead of calling them directly.
+MandelbrotBatchKernel sse2Kernel(const KernelOptions &options);
+MandelbrotBatchKernel avx2Kernel(const KernelOptions &options);
+MandelbrotBatchKernel avx512Kernel(const KernelOptions &options);
@@ -0,0 +1,79 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SimdKernelImpl.h"
+#include "SimdKernels.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx2Double
+    {
+        using Real = double;
+        using Vec = __m256d;
+        using Mask = __m256d;
+        static constexpr int lanes = 4;
+        // FMA has its own cpuid bit, and this unit is only built for AVX2
+        static constexpr bool hasFma = false;
+
+        static Vec load(const double *p) { return _mm256_load_pd(p); }
+        static void store(double *p, Vec v) { _mm256_store_pd(p, v); }
+        static Vec broadcast(double v) { return _mm256_set1_pd(v); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+        static Mask none() { return _mm256_setzero_pd(); }
+        static Mask lessEqual(Vec a, Vec b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static Mask both(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+        static Mask either(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+        // a and not b
+        static Mask bothNot(Mask a, Mask b) { return _mm256_andnot_pd(b, a); }
+        static bool any(Mask m) { return _mm256_movemask_pd(m) != 0; }
+        static int bits(Mask m) { return _mm256_movemask_pd(m); }
+        // a where m is set, b elsewhere
+        static Vec select(Mask m, Vec a, Vec b) { return _mm256_blendv_pd(b, a, m); }
+        // a + b where m is set, a elsewhere
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm256_add_pd(a, _mm256_and_pd(m, b)); }
+    };
+
+    struct Avx2Float
+    {
+        using Real = float;
+        using Vec = __m256;
+        using Mask = __m256;
+        static constexpr int lanes = 8;
+
+        static Vec load(const float *p) { return _mm256_load_ps(p); }
+        static void store(float *p, Vec v) { _mm256_store_ps(p, v); }
+        static Vec broadcast(float v) { return _mm256_set1_ps(v); }
+        static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+        static Mask none() { return _mm256_setzero_ps(); }
+        static Mask lessEqual(Vec a, Vec b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static Mask both(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static Mask either(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+        static Mask bothNot(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+        static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+        static int bits(Mask m) { return _mm256_movemask_ps(m); }
+        static Vec select(Mask m, Vec a, Vec b) { return _mm256_blendv_ps(b, a, m); }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm256_add_ps(a, _mm256_and_ps(m, b)); }
+    };
+} // namespace
+
+MandelbrotBatchKernel avx2Kernel(const KernelOptions &options)
+{
+    switch (options.precision)
+    {
+    case Precision::Single:
+        return laneKernel<Avx2Float>(options);
+    case Precision::DoubleDouble:
+        return doubleDoubleLaneKernel<Avx2Double>(options);
+    case Precision::Perturbation:
+        return perturbationLaneKernel<Avx2Double>(options);
+    default:
+        return laneKernel<Avx2Double>(options);
+    }
+}
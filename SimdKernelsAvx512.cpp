@@ -0,0 +1,78 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SimdKernelImpl.h"
+#include "SimdKernels.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    struct Avx512Double
+    {
+        using Real = double;
+        using Vec = __m512d;
+        using Mask = __mmask8;
+        static constexpr int lanes = 8;
+        // AVX512F includes FMA, which gives the double-double kernel an exact product in one instruction
+        static constexpr bool hasFma = true;
+
+        static Vec load(const double *p) { return _mm512_load_pd(p); }
+        static void store(double *p, Vec v) { _mm512_store_pd(p, v); }
+        static Vec broadcast(double v) { return _mm512_set1_pd(v); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+        // a * b - c, rounded once
+        static Vec fms(Vec a, Vec b, Vec c) { return _mm512_fmsub_pd(a, b, c); }
+        static Mask none() { return 0; }
+        static Mask lessEqual(Vec a, Vec b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+        static Mask both(Mask a, Mask b) { return a & b; }
+        static Mask either(Mask a, Mask b) { return a | b; }
+        static Mask bothNot(Mask a, Mask b) { return a & ~b; }
+        static bool any(Mask m) { return m != 0; }
+        static int bits(Mask m) { return m; }
+        static Vec select(Mask m, Vec a, Vec b) { return _mm512_mask_blend_pd(m, b, a); }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm512_mask_add_pd(a, m, a, b); }
+    };
+
+    struct Avx512Float
+    {
+        using Real = float;
+        using Vec = __m512;
+        using Mask = __mmask16;
+        static constexpr int lanes = 16;
+
+        static Vec load(const float *p) { return _mm512_load_ps(p); }
+        static void store(float *p, Vec v) { _mm512_store_ps(p, v); }
+        static Vec broadcast(float v) { return _mm512_set1_ps(v); }
+        static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+        static Mask none() { return 0; }
+        static Mask lessEqual(Vec a, Vec b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+        static Mask both(Mask a, Mask b) { return a & b; }
+        static Mask either(Mask a, Mask b) { return a | b; }
+        static Mask bothNot(Mask a, Mask b) { return a & ~b; }
+        static bool any(Mask m) { return m != 0; }
+        static int bits(Mask m) { return m; }
+        static Vec select(Mask m, Vec a, Vec b) { return _mm512_mask_blend_ps(m, b, a); }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm512_mask_add_ps(a, m, a, b); }
+    };
+} // namespace
+
+MandelbrotBatchKernel avx512Kernel(const KernelOptions &options)
+{
+    switch (options.precision)
+    {
+    case Precision::Single:
+        return laneKernel<Avx512Float>(options);
+    case Precision::DoubleDouble:
+        return doubleDoubleLaneKernel<Avx512Double>(options);
+    case Precision::Perturbation:
+        return perturbationLaneKernel<Avx512Double>(options);
+    default:
+        return laneKernel<Avx512Double>(options);
+    }
+}
@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "SimdKernelImpl.h"
+#include "SimdKernels.h"
+
+#include <immintrin.h>
+
+namespace
+{
+    struct Sse2Double
+    {
+        using Real = double;
+        using Vec = __m128d;
+        using Mask = __m128d;
+        static constexpr int lanes = 2;
+        static constexpr bool hasFma = false;
+
+        static Vec load(const double *p) { return _mm_load_pd(p); }
+        static void store(double *p, Vec v) { _mm_store_pd(p, v); }
+        static Vec broadcast(double v) { return _mm_set1_pd(v); }
+        static Vec add(Vec a, Vec b) { return _mm_add_pd(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_pd(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_pd(a, b); }
+        static Mask none() { return _mm_setzero_pd(); }
+        static Mask lessEqual(Vec a, Vec b) { return _mm_cmple_pd(a, b); }
+        static Mask both(Mask a, Mask b) { return _mm_and_pd(a, b); }
+        static Mask either(Mask a, Mask b) { return _mm_or_pd(a, b); }
+        // a and not b
+        static Mask bothNot(Mask a, Mask b) { return _mm_andnot_pd(b, a); }
+        static bool any(Mask m) { return _mm_movemask_pd(m) != 0; }
+        static int bits(Mask m) { return _mm_movemask_pd(m); }
+        // SSE2 has no blend instruction
+        static Vec select(Mask m, Vec a, Vec b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm_add_pd(a, _mm_and_pd(m, b)); }
+    };
+
+    struct Sse2Float
+    {
+        using Real = float;
+        using Vec = __m128;
+        using Mask = __m128;
+        static constexpr int lanes = 4;
+
+        static Vec load(const float *p) { return _mm_load_ps(p); }
+        static void store(float *p, Vec v) { _mm_store_ps(p, v); }
+        static Vec broadcast(float v) { return _mm_set1_ps(v); }
+        static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+        static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+        static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+        static Mask none() { return _mm_setzero_ps(); }
+        static Mask lessEqual(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+        static Mask both(Mask a, Mask b) { return _mm_and_ps(a, b); }
+        static Mask either(Mask a, Mask b) { return _mm_or_ps(a, b); }
+        static Mask bothNot(Mask a, Mask b) { return _mm_andnot_ps(b, a); }
+        static bool any(Mask m) { return _mm_movemask_ps(m) != 0; }
+        static int bits(Mask m) { return _mm_movemask_ps(m); }
+        static Vec select(Mask m, Vec a, Vec b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+        static Vec addWhere(Mask m, Vec a, Vec b) { return _mm_add_ps(a, _mm_and_ps(m, b)); }
+    };
+} // namespace
+
+MandelbrotBatchKernel sse2Kernel(const KernelOptions &options)
+{
+    switch (options.precision)
+    {
+    case Precision::Single:
+        return laneKernel<Sse2Float>(options);
+    case Precision::DoubleDouble:
+        return doubleDoubleLaneKernel<Sse2Double>(options);
+    case Precision::Perturbation:
+        return perturbationLaneKernel<Sse2Double>(options);
+    default:
+        return laneKernel<Sse2Double>(options);
+    }
+}
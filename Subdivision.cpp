@@ -0,0 +1,206 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Subdivision.h"
+
+#include <QtConcurrent/QtConcurrent>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+    // lines and rows are inclusive and include the border, which is known by the time the rectangle is processed
+    struct Rectangle
+    {
+        int firstLine;
+        int lastLine;
+        int firstRow;
+        int lastRow;
+    };
+
+    // below this many lines or rows inside the border, iterating the rest is cheaper than checking and splitting
+    constexpr int minimumInside = 4;
+    // Bands of the same count aren't simply connected: the whole frame of the full set is surrounded by 1s, for
+    // example. Rectangles are only filled once they are small enough that a uniform border means a uniform inside.
+    constexpr int maximumFill = 64;
+
+    struct Task
+    {
+        Rectangle rectangle;
+        Rectangle halves[2];
+        int halfCount = 0;
+        SubdivisionStats stats;
+    };
+
+    template<typename Count>
+    class Subdivider
+    {
+    public:
+        Subdivider(MandelbrotBatchKernel kernel, const PointBatch &frame, int lines, int size)
+            : m_kernel{kernel},
+              m_frame{frame},
+              m_results{static_cast<Count *>(frame.results)},
+              m_lines{lines},
+              m_size{size}
+        {
+        }
+
+        // iterates the given pixels in one batch
+        void calculate(const std::vector<std::size_t> &pixels, SubdivisionStats &stats) const
+        {
+            if (pixels.empty())
+                return;
+            // reused across calls, since most batches are a single short line
+            thread_local std::vector<Count> results;
+            results.resize(pixels.size());
+
+            auto batch = m_frame;
+            batch.pixels = pixels.data();
+            batch.results = results.data();
+            batch.count = pixels.size();
+            stats.skipped += m_kernel(batch);
+            stats.iterated += pixels.size();
+            for (std::size_t i = 0; i < pixels.size(); ++i)
+                m_results[pixels[i]] = results[i];
+        }
+
+        void calculateBorder(SubdivisionStats &stats) const
+        {
+            std::vector<std::size_t> pixels;
+            const auto lastLine = m_lines - 1;
+            const auto lastRow = m_size - 1;
+            for (int row = 0; row <= lastRow; ++row)
+            {
+                pixels.push_back(index(0, row));
+                if (lastLine > 0)
+                    pixels.push_back(index(lastLine, row));
+            }
+            for (int line = 1; line < lastLine; ++line)
+            {
+                pixels.push_back(index(line, 0));
+                if (lastRow > 0)
+                    pixels.push_back(index(line, lastRow));
+            }
+            calculate(pixels, stats);
+        }
+
+        // Fills, iterates or splits task.rectangle. Only writes pixels inside its border, so rectangles of the same
+        // round can be processed concurrently.
+        void process(Task &task) const
+        {
+            const auto &r = task.rectangle;
+            const auto lines = r.lastLine - r.firstLine - 1;
+            const auto rows = r.lastRow - r.firstRow - 1;
+            if (lines <= 0 || rows <= 0)
+                return;
+
+            const auto count = lines <= maximumFill && rows <= maximumFill ? uniformBorder(r) : -1;
+            if (count >= 0)
+            {
+                for (int line = r.firstLine + 1; line < r.lastLine; ++line)
+                    std::fill_n(m_results + index(line, r.firstRow + 1), rows, static_cast<Count>(count));
+                task.stats.filled += static_cast<std::size_t>(lines) * rows;
+                return;
+            }
+
+            std::vector<std::size_t> pixels;
+            if (lines < minimumInside || rows < minimumInside)
+            {
+                for (int line = r.firstLine + 1; line < r.lastLine; ++line)
+                    for (int row = r.firstRow + 1; row < r.lastRow; ++row)
+                        pixels.push_back(index(line, row));
+                calculate(pixels, task.stats);
+                return;
+            }
+
+            // split across the longer side, and iterate the line the halves share
+            if (lines >= rows)
+            {
+                const auto middle = (r.firstLine + r.lastLine) / 2;
+                for (int row = r.firstRow + 1; row < r.lastRow; ++row)
+                    pixels.push_back(index(middle, row));
+                task.halves[0] = {r.firstLine, middle, r.firstRow, r.lastRow};
+                task.halves[1] = {middle, r.lastLine, r.firstRow, r.lastRow};
+            }
+            else
+            {
+                const auto middle = (r.firstRow + r.lastRow) / 2;
+                for (int line = r.firstLine + 1; line < r.lastLine; ++line)
+                    pixels.push_back(index(line, middle));
+                task.halves[0] = {r.firstLine, r.lastLine, r.firstRow, middle};
+                task.halves[1] = {r.firstLine, r.lastLine, middle, r.lastRow};
+            }
+            task.halfCount = 2;
+            calculate(pixels, task.stats);
+        }
+
+    private:
+        std::size_t index(int line, int row) const { return static_cast<std::size_t>(line) * m_size + row; }
+
+        // the count all of the border has in common, or -1
+        int uniformBorder(const Rectangle &r) const
+        {
+            const auto count = m_results[index(r.firstLine, r.firstRow)];
+            for (int row = r.firstRow; row <= r.lastRow; ++row)
+                if (m_results[index(r.firstLine, row)] != count || m_results[index(r.lastLine, row)] != count)
+                    return -1;
+            for (int line = r.firstLine + 1; line < r.lastLine; ++line)
+                if (m_results[index(line, r.firstRow)] != count || m_results[index(line, r.lastRow)] != count)
+                    return -1;
+            return count;
+        }
+
+        MandelbrotBatchKernel m_kernel;
+        PointBatch m_frame;
+        Count *m_results;
+        int m_lines;
+        int m_size;
+    };
+
+    template<typename Count>
+    SubdivisionStats subdivide(MandelbrotBatchKernel kernel, const PointBatch &frame, int lines, int size, bool parallel)
+    {
+        SubdivisionStats stats;
+        const Subdivider<Count> subdivider{kernel, frame, lines, size};
+        subdivider.calculateBorder(stats);
+
+        // breadth first, so each round is a list of disjoint rectangles
+        std::vector<Task> round(1);
+        round.front().rectangle = {0, lines - 1, 0, size - 1};
+        while (!round.empty())
+        {
+            const auto process = [&subdivider](Task &task) { subdivider.process(task); };
+            if (parallel)
+                QtConcurrent::blockingMap(round, process);
+            else
+                std::for_each(round.begin(), round.end(), process);
+
+            std::vector<Task> next;
+            for (const auto &task : round)
+            {
+                stats.iterated += task.stats.iterated;
+                stats.filled += task.stats.filled;
+                stats.skipped += task.stats.skipped;
+                for (int i = 0; i < task.halfCount; ++i)
+                {
+                    next.emplace_back();
+                    next.back().rectangle = task.halves[i];
+                }
+            }
+            round = std::move(next);
+        }
+        return stats;
+    }
+} // namespace
+
+SubdivisionStats
+calculateSubdivided(MandelbrotBatchKernel kernel, const PointBatch &frame, int lines, int size, bool parallel)
+{
+    if (lines <= 0 || size <= 0)
+        return {};
+    return selectCountType(frame.maxIterations, [&](auto count) {
+        return subdivide<decltype(count)>(kernel, frame, lines, size, parallel);
+    });
+}
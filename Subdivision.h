@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "MandelbrotKernel.h"
+
+#include <cstddef>
+
+struct SubdivisionStats
+{
+    // points that went through the kernel
+    std::size_t iterated = 0;
+    // points that got the count of the rectangle around them without iterating
+    std::size_t filled = 0;
+    // what the kernel reported as skipped, see MandelbrotBatchKernel
+    std::size_t skipped = 0;
+};
+
+// Mariani-Silver subdivision of a frame of lines x size pixels, stored by line like the rest of the renderer.
+// frame covers the whole frame contiguously, without PointBatch::pixels, and its maxIterations gives the count type of
+// its results. Only the border of a rectangle is iterated; if all of it has the same count, the inside gets that count
+// too, otherwise the rectangle is split in two along a line that is iterated next. With parallel, each round of
+// rectangles is spread over the global thread pool. Detail that crosses no border, such as thin filaments, gets filled
+// over, so the result can differ from iterating every pixel.
+SubdivisionStats
+calculateSubdivided(MandelbrotBatchKernel kernel, const PointBatch &frame, int lines, int size, bool parallel);
@@ -0,0 +1,38 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "Tiles.h"
+
+#include <algorithm>
+
+std::vector<Tile> frameTiles(int lines, int size, int tileSize)
+{
+    std::vector<Tile> tiles;
+    if (tileSize <= 0)
+        return tiles;
+    tiles.reserve(static_cast<std::size_t>((lines + tileSize - 1) / tileSize) * ((size + tileSize - 1) / tileSize));
+    for (int firstLine = 0; firstLine < lines; firstLine += tileSize)
+    {
+        const auto tileLines = std::min(tileSize, lines - firstLine);
+        for (int firstRow = 0; firstRow < size; firstRow += tileSize)
+            tiles.push_back({firstLine, firstRow, tileLines, std::min(tileSize, size - firstRow)});
+    }
+    return tiles;
+}
+
+std::size_t calculateTile(MandelbrotBatchKernel kernel, const PointBatch &frame, int size, const Tile &tile)
+{
+    const auto countBytes = countSize(countType(frame.maxIterations));
+    std::size_t skipped = 0;
+    auto lineBatch = frame;
+    lineBatch.count = tile.rows;
+    for (auto line = tile.firstLine; line < tile.firstLine + tile.lines; ++line)
+    {
+        const auto pixel = static_cast<std::size_t>(line) * size + tile.firstRow;
+        lineBatch.first = frame.first + pixel;
+        lineBatch.results = static_cast<unsigned char *>(frame.results) + pixel * countBytes;
+        skipped += kernel(lineBatch);
+    }
+    return skipped;
+}
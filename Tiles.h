@@ -0,0 +1,28 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "MandelbrotKernel.h"
+
+#include <cstddef>
+#include <vector>
+
+// A square of tileSize x tileSize pixels, cut short at the right and bottom edges of the frame.
+struct Tile
+{
+    int firstLine = 0;
+    int firstRow = 0;
+    int lines = 0;
+    int rows = 0;
+};
+
+// The tiles covering a frame of lines x size pixels, in memory order: all tiles of the first tileSize lines from left
+// to right, then those of the next tileSize lines, and so on.
+std::vector<Tile> frameTiles(int lines, int size, int tileSize);
+
+// Iterates tile of frame, which covers lines x size pixels contiguously like in calculateSubdivided(), one line of the
+// tile per kernel call. The counts go straight to their place in frame.results. Returns what the kernel reported as
+// skipped.
+std::size_t calculateTile(MandelbrotBatchKernel kernel, const PointBatch &frame, int size, const Tile &tile);
@@ -0,0 +1,95 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include "MandelbrotKernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+// A square region of the complex plane. Kernels compute pixel coordinates as offsets from the center rather than by
+// stepping from one edge, so each of them is rounded only once when it's narrowed to a kernel's precision. The center
+// is a double-double so views can go deeper than double resolves.
+struct Viewport
+{
+    DoubleDouble centerX;
+    DoubleDouble centerY;
+    double width = 4;
+    // decimal digits of the center for views deeper than double-double, see ReferenceOrbit; empty means
+    // centerX/centerY are exact
+    std::string preciseCenterX;
+    std::string preciseCenterY;
+
+    double pixelSpacing(int size) const { return width / size; }
+};
+
+// Lines [first, last), see pointOffset()
+struct LineRange
+{
+    int first = 0;
+    int last = 0;
+};
+
+// How a view lines up with its reflection in the real axis: line col shows the complex conjugates of line mirror - col.
+// Only the computed lines have to be iterated; the mirrored ones are copies of their reflections.
+struct RealAxisSymmetry
+{
+    int mirror = 0;
+    LineRange computed[2];
+    LineRange mirrored;
+};
+
+// Works for any view that straddles the axis, as long as its pixels land on pixels when reflected, which is the case for
+// any center that is a multiple of half a pixel away from the axis. The larger side of the axis is computed, along with
+// whatever part of it has no reflection in the view. If nothing can be mirrored, everything is computed.
+inline RealAxisSymmetry realAxisSymmetry(const Viewport &viewport, int size)
+{
+    RealAxisSymmetry symmetry;
+    symmetry.computed[0] = {0, size};
+
+    // solves centerY + (col - size / 2) * spacing == -(centerY + (mirror - col - size / 2) * spacing) for mirror
+    const auto mirror = size - 2 * (viewport.centerY.hi + viewport.centerY.lo) / viewport.pixelSpacing(size);
+    const auto rounded = std::lround(mirror);
+    if (std::abs(mirror - rounded) > 1e-6 || rounded < 1 || rounded >= 2 * size)
+        return symmetry;
+
+    const auto m = static_cast<int>(rounded);
+    const auto first = std::max(0, m - size + 1);
+    const auto last = (m + 1) / 2;
+    if (first >= last)
+        return symmetry;
+    symmetry.mirror = m;
+    symmetry.mirrored = {first, last};
+    symmetry.computed[0] = {0, first};
+    symmetry.computed[1] = {last, size};
+    return symmetry;
+}
+
+// The cheapest precision that still resolves neighbouring pixels: the pixel spacing must stay well above the rounding
+// error of the largest coordinate in the view, with some headroom for the error that builds up while iterating.
+// Never returns Precision::Automatic.
+inline Precision automaticPrecision(const Viewport &viewport, int size)
+{
+    constexpr auto headroom = 32;
+    const auto magnitude = std::max(std::abs(viewport.centerX.hi), std::abs(viewport.centerY.hi)) + viewport.width / 2;
+    const auto resolves = [&](double epsilon) { return viewport.pixelSpacing(size) > headroom * epsilon * magnitude; };
+    if (resolves(std::numeric_limits<float>::epsilon()))
+        return Precision::Single;
+    if (resolves(std::numeric_limits<double>::epsilon()))
+        return Precision::Double;
+    if (resolves(std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon()))
+        return Precision::DoubleDouble;
+    return Precision::Perturbation;
+}
+
+// An iteration cap that grows with the zoom depth, since points near the boundary take longer to escape the deeper the
+// view: 100 for the whole set, plus 50 for every tenfold zoom.
+inline int automaticIterationCap(const Viewport &viewport)
+{
+    const auto depth = std::max(0.0, std::log10(4 / viewport.width));
+    return 100 + static_cast<int>(std::lround(50 * depth));
+}
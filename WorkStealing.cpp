@@ -0,0 +1,94 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#include "WorkStealing.h"
+
+#include "RenderThreadPool.h"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace
+{
+    // The indices [first, last) a worker has left, packed into one word so that the owner taking from the front and
+    // thieves taking from the back agree through one compare-and-swap. A block of indices is only ever handed out
+    // once, so a word never goes back to a value a stale compare-and-swap could mistake for its own.
+    struct alignas(64) Block
+    {
+        std::atomic<std::uint64_t> range{0};
+    };
+
+    std::uint64_t packRange(std::uint32_t first, std::uint32_t last)
+    {
+        return static_cast<std::uint64_t>(first) << 32 | last;
+    }
+
+    std::uint32_t rangeFirst(std::uint64_t range)
+    {
+        return static_cast<std::uint32_t>(range >> 32);
+    }
+
+    std::uint32_t rangeLast(std::uint64_t range)
+    {
+        return static_cast<std::uint32_t>(range);
+    }
+} // namespace
+
+std::size_t runWorkStealing(std::size_t count, RenderThreadPool &pool, const std::function<void(std::size_t)> &work)
+{
+    if (count == 0)
+        return 0;
+    const auto workers = pool.threadCount();
+    std::vector<Block> blocks(workers);
+    for (int i = 0; i < workers; ++i)
+        blocks[i].range = packRange(static_cast<std::uint32_t>(count * i / workers),
+                                    static_cast<std::uint32_t>(count * (i + 1) / workers));
+
+    std::atomic<std::size_t> steals{0};
+    const auto worker = [&](int self) {
+        auto &own = blocks[self].range;
+        for (;;)
+        {
+            auto range = own.load(std::memory_order_acquire);
+            while (rangeFirst(range) < rangeLast(range)
+                   && !own.compare_exchange_weak(range, packRange(rangeFirst(range) + 1, rangeLast(range)),
+                                                 std::memory_order_acq_rel, std::memory_order_acquire))
+            {
+            }
+            if (rangeFirst(range) < rangeLast(range))
+            {
+                work(rangeFirst(range));
+                continue;
+            }
+
+            // Out of work: take the back half of someone else's block. Only the owner stores into its own word, and
+            // only while it's empty, which thieves leave alone.
+            auto stolen = false;
+            for (int i = 1; i < workers && !stolen; ++i)
+            {
+                auto &victim = blocks[(self + i) % workers].range;
+                auto victimRange = victim.load(std::memory_order_acquire);
+                while (rangeFirst(victimRange) < rangeLast(victimRange))
+                {
+                    const auto split = rangeLast(victimRange) - (rangeLast(victimRange) - rangeFirst(victimRange) + 1) / 2;
+                    if (victim.compare_exchange_weak(victimRange, packRange(rangeFirst(victimRange), split),
+                                                     std::memory_order_acq_rel, std::memory_order_acquire))
+                    {
+                        own.store(packRange(split, rangeLast(victimRange)), std::memory_order_release);
+                        steals.fetch_add(1, std::memory_order_relaxed);
+                        stolen = true;
+                        break;
+                    }
+                }
+            }
+            // nothing left anywhere but with workers that are already on it
+            if (!stolen)
+                return;
+        }
+    };
+
+    pool.run(worker);
+    return steals;
+}
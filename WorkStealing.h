@@ -0,0 +1,16 @@
+// SPDX-FileCopyrightText: 2023 Klarälvdalens Datakonsult AB, a KDAB Group company, info@kdab.com
+//
+// SPDX-License-Identifier: GPL-3.0-or-later
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+class RenderThreadPool;
+
+// Calls work for every index in [0, count) on the threads of pool and returns once all calls are done. Every thread
+// starts on its own contiguous block of indices, taken from the front in order. A thread that runs out steals the back
+// half of the first block after its own that still has indices left, so expensive interior tiles don't hold up the
+// frame. Taking and stealing are a single compare-and-swap each, without locks. Returns how many steals there were.
+std::size_t runWorkStealing(std::size_t count, RenderThreadPool &pool, const std::function<void(std::size_t)> &work);